@@ -0,0 +1,244 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "errors.h"
+#include "ktx.h"
+
+/*
+
+Bakes an image into a KTX file of DXT5 (BC3) compressed mip levels, which
+texture_loader.c uploads as they are: no PNG decode at startup, and small
+thumbnails sample small levels instead of aliasing across a big one.
+
+    ./build_bake                                 bakes sprite.png into sprite.ktx
+    ./bake_textures.bin <in.png> <out.ktx>
+
+Each level is half the size of the one before, as long as both sides of
+the one before are even. For sprite.png (7x2 sprites of 200 pixels) that
+stops at 25 pixel sprites, before a level would blend neighbouring ones.
+
+Levels are box filtered weighted by alpha, so the transparent pixels
+around a piece do not darken its edges as it shrinks.
+
+*/
+
+#define BLOCK_BYTES 16
+
+struct Image {
+    int width;
+    int height;
+    unsigned char *pixels; // RGBA
+};
+
+void halveImage(const struct Image *src, struct Image *dst) {
+    dst->width = src->width / 2;
+    dst->height = src->height / 2;
+    dst->pixels = malloc(dst->width * dst->height * 4);
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            int sums[4] = { 0, 0, 0, 0 };
+            for (int i = 0; i < 4; i++) {
+                unsigned char *p = &src->pixels[((2 * y + i / 2) * src->width + 2 * x + i % 2) * 4];
+                for (int c = 0; c < 3; c++) {
+                    sums[c] += p[c] * p[3];
+                }
+                sums[3] += p[3];
+            }
+            unsigned char *q = &dst->pixels[(y * dst->width + x) * 4];
+            for (int c = 0; c < 3; c++) {
+                q[c] = sums[3] > 0 ? (sums[c] + sums[3] / 2) / sums[3] : 0;
+            }
+            q[3] = (sums[3] + 2) / 4;
+        }
+    }
+}
+
+uint16_t toRgb565(const int rgb[3]) {
+    return (uint16_t)(((rgb[0] * 31 + 127) / 255) << 11 |
+                      ((rgb[1] * 63 + 127) / 255) << 5 |
+                      ((rgb[2] * 31 + 127) / 255));
+}
+
+void fromRgb565(uint16_t color, int rgb[3]) {
+    int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Alpha: the two endpoints, then 3 bit indices into the 8 values between
+// them, 16 of them in 6 bytes.
+void encodeAlphaBlock(unsigned char texels[16][4], unsigned char *out) {
+    int maxAlpha = 0, minAlpha = 255;
+    for (int i = 0; i < 16; i++) {
+        if (texels[i][3] > maxAlpha) maxAlpha = texels[i][3];
+        if (texels[i][3] < minAlpha) minAlpha = texels[i][3];
+    }
+    int palette[8];
+    palette[0] = maxAlpha;
+    palette[1] = minAlpha;
+    for (int i = 1; i < 7; i++) {
+        palette[i + 1] = ((7 - i) * maxAlpha + i * minAlpha + 3) / 7;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0;
+        if (maxAlpha > minAlpha) {
+            for (int j = 1; j < 8; j++) {
+                if (abs(palette[j] - texels[i][3]) < abs(palette[best] - texels[i][3])) {
+                    best = j;
+                }
+            }
+        }
+        indices |= (uint64_t)best << (3 * i);
+    }
+    out[0] = maxAlpha;
+    out[1] = minAlpha;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// Color: two RGB565 endpoints spanning the block's visible texels, then
+// 2 bit indices into them and the two colors a third of the way between.
+void encodeColorBlock(unsigned char texels[16][4], unsigned char *out) {
+    int minRgb[3] = { 255, 255, 255 }, maxRgb[3] = { 0, 0, 0 };
+    bool anyVisible = false;
+    for (int i = 0; i < 16; i++) {
+        if (texels[i][3] == 0) {
+            continue;
+        }
+        anyVisible = true;
+        for (int c = 0; c < 3; c++) {
+            if (texels[i][c] < minRgb[c]) minRgb[c] = texels[i][c];
+            if (texels[i][c] > maxRgb[c]) maxRgb[c] = texels[i][c];
+        }
+    }
+    if (!anyVisible) {
+        memset(out, 0, 8);
+        return;
+    }
+    // Pull the ends in a little, which lowers the error of the texels
+    // between them more than it raises theirs
+    for (int c = 0; c < 3; c++) {
+        int inset = (maxRgb[c] - minRgb[c]) / 16;
+        minRgb[c] += inset;
+        maxRgb[c] -= inset;
+    }
+    uint16_t color0 = toRgb565(maxRgb);
+    uint16_t color1 = toRgb565(minRgb);
+    if (color0 < color1) {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+    int palette[4][3];
+    fromRgb565(color0, palette[0]);
+    fromRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0;
+        int bestDistance = -1;
+        for (int j = 0; j < 4 && color0 != color1; j++) {
+            int distance = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = palette[j][c] - texels[i][c];
+                distance += d * d;
+            }
+            if (bestDistance < 0 || distance < bestDistance) {
+                best = j;
+                bestDistance = distance;
+            }
+        }
+        indices |= (uint32_t)best << (2 * i);
+    }
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// Compresses image into 4x4 blocks, row by row. Blocks past the right or
+// bottom edge repeat the edge texels.
+unsigned char *compressImage(const struct Image *image, uint32_t *size) {
+    int blocksAcross = (image->width + 3) / 4;
+    int blocksDown = (image->height + 3) / 4;
+    *size = blocksAcross * blocksDown * BLOCK_BYTES;
+    unsigned char *blocks = malloc(*size);
+    for (int by = 0; by < blocksDown; by++) {
+        for (int bx = 0; bx < blocksAcross; bx++) {
+            unsigned char texels[16][4];
+            for (int i = 0; i < 16; i++) {
+                int x = bx * 4 + i % 4;
+                int y = by * 4 + i / 4;
+                x = x < image->width ? x : image->width - 1;
+                y = y < image->height ? y : image->height - 1;
+                memcpy(texels[i], &image->pixels[(y * image->width + x) * 4], 4);
+            }
+            unsigned char *block = &blocks[(by * blocksAcross + bx) * BLOCK_BYTES];
+            encodeAlphaBlock(texels, block);
+            encodeColorBlock(texels, block + 8);
+        }
+    }
+    return blocks;
+}
+
+int bakeTexture(char *inFile, char *outFile) {
+    struct Image level;
+    int channels;
+    level.pixels = stbi_load(inFile, &level.width, &level.height, &channels, 4);
+    if (level.pixels == NULL) {
+        set_error(1, "Could not decode %s: %s", inFile, stbi_failure_reason());
+        return 1;
+    }
+
+    struct KtxImage ktx;
+    ktx.internalFormat = KTX_COMPRESSED_RGBA_DXT5;
+    ktx.baseInternalFormat = KTX_RGBA;
+    ktx.width = level.width;
+    ktx.height = level.height;
+    ktx.numLevels = 0;
+    while (true) {
+        ktx.levels[ktx.numLevels] = compressImage(&level, &ktx.levelSizes[ktx.numLevels]);
+        printf("level %d: %dx%d, %u bytes\n",
+            ktx.numLevels, level.width, level.height, ktx.levelSizes[ktx.numLevels]);
+        ktx.numLevels++;
+        if (level.width % 2 != 0 || level.height % 2 != 0 || ktx.numLevels == KTX_MAX_LEVELS) {
+            break;
+        }
+        struct Image half;
+        halveImage(&level, &half);
+        free(level.pixels);
+        level = half;
+    }
+    free(level.pixels);
+
+    int result = writeKtx(outFile, &ktx);
+    for (int i = 0; i < ktx.numLevels; i++) {
+        free(ktx.levels[i]);
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <in.png> <out.ktx>\n", argv[0]);
+        return 1;
+    }
+    if (bakeTexture(argv[1], argv[2]) != 0) {
+        finalize_error();
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,450 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "errors.h"
+#include "board.h"
+
+void clearBoard(struct Board *board) {
+    memset(board, 0, sizeof(struct Board));
+    board->sideToMove = White;
+    board->epSquare = NO_SQUARE;
+    board->fullmoveNumber = 1;
+}
+
+void initBoard(struct Board *board) {
+    static const enum PieceType backRank[8] = {
+        Rook, Knight, Biship, Queen, King, Biship, Knight, Rook
+    };
+
+    clearBoard(board);
+
+    for (int col = 0; col < 8; col++) {
+        boardPutPiece(board, col, MAKE_PIECE(Black, backRank[col]));
+        boardPutPiece(board, 8 + col, BPawn);
+        boardPutPiece(board, 48 + col, WPawn);
+        boardPutPiece(board, 56 + col, MAKE_PIECE(White, backRank[col]));
+    }
+    board->castling = CASTLE_ALL;
+    board->hash = computeBoardHash(board);
+}
+
+enum Piece boardPieceAt(const struct Board *board, int square) {
+    uint64_t bit = SQUARE_BIT(square);
+    if (!(board->occupied & bit)) {
+        return Blank;
+    }
+    enum Color color = (board->colors[Black] & bit) ? Black : White;
+    for (int type = 0; type < NUM_PIECE_TYPES; type++) {
+        if (board->pieceTypes[type] & bit) {
+            return MAKE_PIECE(color, type);
+        }
+    }
+    return Blank;
+}
+
+// Places piece on an empty square. Putting a Blank is a no-op.
+void boardPutPiece(struct Board *board, int square, enum Piece piece) {
+    if (piece == Blank) {
+        return;
+    }
+    boardTogglePiece(board, square, piece);
+}
+
+void boardRemovePiece(struct Board *board, int square) {
+    enum Piece piece = boardPieceAt(board, square);
+    if (piece != Blank) {
+        boardTogglePiece(board, square, piece);
+    }
+}
+
+// Moves whatever is on srcPos to destPos, capturing anything on destPos.
+void boardMovePiece(struct Board *board, int srcPos, int destPos) {
+    if (srcPos == destPos) {
+        return;
+    }
+    enum Piece piece = boardPieceAt(board, srcPos);
+    boardRemovePiece(board, destPos);
+    boardRemovePiece(board, srcPos);
+    boardPutPiece(board, destPos, piece);
+}
+
+// Returns -1 if color has no king on the board.
+int boardKingSquare(const struct Board *board, enum Color color) {
+    uint64_t kings = pieceBits(board, color, King);
+    if (kings == 0) {
+        return -1;
+    }
+    return lsbIndex(kings);
+}
+
+// Expands the bitboards into the one-enum-per-square layout the pieces
+// vertex buffer expects.
+void boardToSquares(const struct Board *board, enum Piece squares[64]) {
+    for (int i = 0; i < 64; i++) {
+        squares[i] = Blank;
+    }
+    for (int type = 0; type < NUM_PIECE_TYPES; type++) {
+        for (int color = White; color <= Black; color++) {
+            uint64_t bits = pieceBits(board, color, type);
+            while (bits) {
+                squares[popLsb(&bits)] = MAKE_PIECE(color, type);
+            }
+        }
+    }
+}
+
+// Packs the board 4 bits per square, square n in bits 4 * (n % 8) of
+// nibbles[n / 8], for handing whole boards to shaders.
+void boardToNibbles(const struct Board *board, uint32_t nibbles[8]) {
+    for (int i = 0; i < 8; i++) {
+        nibbles[i] = 0x11111111u * NIBBLE_BLANK;
+    }
+    for (int type = 0; type < NUM_PIECE_TYPES; type++) {
+        for (int color = White; color <= Black; color++) {
+            uint64_t bits = pieceBits(board, color, type);
+            while (bits) {
+                int square = popLsb(&bits);
+                int shift = 4 * (square % 8);
+                nibbles[square / 8] &= ~(0xFu << shift);
+                nibbles[square / 8] |= (uint32_t)MAKE_PIECE(color, type) << shift;
+            }
+        }
+    }
+}
+
+static enum Piece pieceFromFenChar(char c) {
+    switch (c) {
+        case 'P': return WPawn;
+        case 'N': return WKnight;
+        case 'B': return WBiship;
+        case 'R': return WRook;
+        case 'K': return WKing;
+        case 'Q': return WQueen;
+        case 'p': return BPawn;
+        case 'n': return BKnight;
+        case 'b': return BBiship;
+        case 'r': return BRook;
+        case 'k': return BKing;
+        case 'q': return BQueen;
+        default: return Blank;
+    }
+}
+
+static bool isFenSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Reads the digits at *c, up to end, as a number of at most max.
+static bool parseFenNumber(const char **c, const char *end, long max, long *number) {
+    const char *p = *c;
+    long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        value = value * 10 + (*p - '0');
+        if (value > max) {
+            return false;
+        }
+    }
+    *number = value;
+    *c = p;
+    return true;
+}
+
+// The castling rights whose king and rook are still on their squares.
+static uint8_t supportedCastling(const struct Board *board) {
+    static const struct {
+        uint8_t right;
+        uint8_t color;
+        uint8_t kingSquare;
+        uint8_t rookSquare;
+    } castleSquares[4] = {
+        { CASTLE_WHITE_KING, White, 60, 63 },
+        { CASTLE_WHITE_QUEEN, White, 60, 56 },
+        { CASTLE_BLACK_KING, Black, 4, 7 },
+        { CASTLE_BLACK_QUEEN, Black, 4, 0 },
+    };
+    uint8_t rights = 0;
+    for (int i = 0; i < 4; i++) {
+        enum Color color = castleSquares[i].color;
+        if ((pieceBits(board, color, King) & SQUARE_BIT(castleSquares[i].kingSquare)) &&
+            (pieceBits(board, color, Rook) & SQUARE_BIT(castleSquares[i].rookSquare))) {
+            rights |= castleSquares[i].right;
+        }
+    }
+    return rights;
+}
+
+// Whether each side has exactly one king and no pawn stands on the first
+// or last row, which movegen takes for granted.
+static bool hasPlayablePieces(const struct Board *board) {
+    uint64_t kings = board->pieceTypes[King];
+    uint64_t backRows = 0xFFULL | (0xFFULL << 56);
+    return popCount(kings & board->colors[White]) == 1 &&
+        popCount(kings & board->colors[Black]) == 1 &&
+        !(board->pieceTypes[Pawn] & backRows);
+}
+
+// Whether the last move can have been a pawn passing over square with a
+// double push: the pawn stands in front of it, and square and the one the
+// pawn came from are empty.
+static bool isPossibleEpSquare(const struct Board *board, int square) {
+    int row = board->sideToMove == White ? 2 : 5;
+    int towardsPawn = board->sideToMove == White ? 8 : -8;
+    return square >= 0 && square < 64 && SQUARE_ROW(square) == row &&
+        !(board->occupied & (SQUARE_BIT(square) | SQUARE_BIT(square - towardsPawn))) &&
+        (pieceBits(board, !board->sideToMove, Pawn) & SQUARE_BIT(square + towardsPawn));
+}
+
+// Whether board is one parseFen could have set up: its bitboards agree
+// with each other, each side has one king, its castling rights and en passant square are backed by
+// pieces, and its hash is up to date. For boards read from files, which
+// movegen trusts to be consistent.
+bool boardIsValid(const struct Board *board) {
+    uint64_t pieces = 0;
+    for (int type = 0; type < NUM_PIECE_TYPES; type++) {
+        if (pieces & board->pieceTypes[type]) {
+            return false;
+        }
+        pieces |= board->pieceTypes[type];
+    }
+    return pieces == board->occupied &&
+        !(board->colors[White] & board->colors[Black]) &&
+        (board->colors[White] | board->colors[Black]) == board->occupied &&
+        hasPlayablePieces(board) &&
+        board->sideToMove <= Black &&
+        (board->castling & ~supportedCastling(board)) == 0 &&
+        (board->epSquare == NO_SQUARE ||
+            (isPossibleEpSquare(board, board->epSquare) &&
+            canCaptureEnPassant(board, board->epSquare, board->sideToMove))) &&
+        board->fullmoveNumber > 0 &&
+        board->hash == computeBoardHash(board);
+}
+
+// Reads a position in Forsyth-Edwards Notation from text, up to end, which
+// need not be 0 terminated. The move counters are optional, so the first
+// four fields of an EPD line read as well. Castling rights whose king or
+// rook has moved are dropped, and so is an en passant square no pawn can
+// capture on. A position without one king a side, or with a pawn on the
+// first or last row, is malformed. Nothing is allocated and no error is set, so
+// any thread can call it. Returns where the FEN ends, or NULL if it is
+// malformed, in which case board is left half set up.
+const char *parseFen(struct Board *board, const char *text, const char *end) {
+    const char *c = text;
+    clearBoard(board);
+
+    // The hash is built up piece by piece rather than with computeBoardHash
+    int square = 0;
+    for (int row = 0; row < 8; row++) {
+        if (row > 0 && (c == end || *c++ != '/')) {
+            return NULL;
+        }
+        int rowEnd = square + 8;
+        while (square < rowEnd) {
+            if (c == end) {
+                return NULL;
+            }
+            if (*c >= '1' && *c <= '8') {
+                square += *c++ - '0';
+                continue;
+            }
+            enum Piece piece = pieceFromFenChar(*c++);
+            if (piece == Blank) {
+                return NULL;
+            }
+            boardTogglePiece(board, square++, piece);
+        }
+        if (square != rowEnd) {
+            return NULL;
+        }
+    }
+    if (!hasPlayablePieces(board)) {
+        return NULL;
+    }
+
+    if (end - c < 2 || *c++ != ' ') {
+        return NULL;
+    }
+    if (*c == 'w') {
+        board->sideToMove = White;
+    } else if (*c == 'b') {
+        board->sideToMove = Black;
+    } else {
+        return NULL;
+    }
+    c++;
+
+    if (end - c < 2 || *c++ != ' ') {
+        return NULL;
+    }
+    if (*c == '-') {
+        c++;
+    } else {
+        for (; c < end && !isFenSpace(*c); c++) {
+            switch (*c) {
+                case 'K': board->castling |= CASTLE_WHITE_KING; break;
+                case 'Q': board->castling |= CASTLE_WHITE_QUEEN; break;
+                case 'k': board->castling |= CASTLE_BLACK_KING; break;
+                case 'q': board->castling |= CASTLE_BLACK_QUEEN; break;
+                default: return NULL;
+            }
+        }
+        if (board->castling == 0) {
+            return NULL;
+        }
+        board->castling &= supportedCastling(board);
+    }
+
+    if (end - c < 2 || *c++ != ' ') {
+        return NULL;
+    }
+    if (*c == '-') {
+        c++;
+    } else {
+        if (end - c < 2 || c[0] < 'a' || c[0] > 'h' || c[1] < '1' || c[1] > '8') {
+            return NULL;
+        }
+        board->epSquare = ('8' - c[1]) * 8 + (c[0] - 'a');
+        if (!isPossibleEpSquare(board, board->epSquare)) {
+            return NULL;
+        }
+        if (!canCaptureEnPassant(board, board->epSquare, board->sideToMove)) {
+            board->epSquare = NO_SQUARE;
+        }
+        c += 2;
+    }
+
+    if (end - c >= 2 && c[0] == ' ' && c[1] >= '0' && c[1] <= '9') {
+        long halfmoveClock;
+        long fullmoveNumber = 1;
+        c++;
+        if (!parseFenNumber(&c, end, UINT8_MAX, &halfmoveClock)) {
+            return NULL;
+        }
+        if (end - c >= 2 && c[0] == ' ' && c[1] >= '0' && c[1] <= '9') {
+            c++;
+            if (!parseFenNumber(&c, end, UINT16_MAX, &fullmoveNumber)) {
+                return NULL;
+            }
+        }
+        board->halfmoveClock = halfmoveClock;
+        if (fullmoveNumber > 0) {
+            board->fullmoveNumber = fullmoveNumber;
+        }
+    }
+    if (c < end && !isFenSpace(*c)) {
+        return NULL;
+    }
+    board->hash ^= boardStateHash(board);
+    return c;
+}
+
+// parseFen for a 0 terminated FEN. Returns 1 and sets the error on
+// malformed input.
+int boardFromFen(struct Board *board, const char *fen) {
+    if (parseFen(board, fen, fen + strlen(fen)) == NULL) {
+        set_error(1, "Bad FEN: %s", fen);
+        return 1;
+    }
+    return 0;
+}
+
+static char *writeFenNumber(char *c, unsigned number) {
+    char digits[10];
+    int numDigits = 0;
+    do {
+        digits[numDigits++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    while (numDigits > 0) {
+        *c++ = digits[--numDigits];
+    }
+    return c;
+}
+
+// Writes board in Forsyth-Edwards Notation into fen, 0 terminated, and
+// returns its length.
+int boardToFen(const struct Board *board, char fen[FEN_MAX_SIZE]) {
+    // Indexed by enum PieceType
+    static const char pieceChars[NUM_PIECE_TYPES] = { 'P', 'N', 'B', 'R', 'K', 'Q' };
+    enum Piece squares[64];
+    boardToSquares(board, squares);
+
+    char *c = fen;
+    for (int row = 0; row < 8; row++) {
+        if (row > 0) {
+            *c++ = '/';
+        }
+        int numBlank = 0;
+        for (int col = 0; col < 8; col++) {
+            enum Piece piece = squares[row * 8 + col];
+            if (piece == Blank) {
+                numBlank++;
+                continue;
+            }
+            if (numBlank > 0) {
+                *c++ = '0' + numBlank;
+                numBlank = 0;
+            }
+            char pieceChar = pieceChars[PIECE_TYPE(piece)];
+            *c++ = PIECE_COLOR(piece) == Black ? pieceChar - 'A' + 'a' : pieceChar;
+        }
+        if (numBlank > 0) {
+            *c++ = '0' + numBlank;
+        }
+    }
+
+    *c++ = ' ';
+    *c++ = board->sideToMove == White ? 'w' : 'b';
+    *c++ = ' ';
+    if (board->castling == 0) {
+        *c++ = '-';
+    }
+    if (board->castling & CASTLE_WHITE_KING) {
+        *c++ = 'K';
+    }
+    if (board->castling & CASTLE_WHITE_QUEEN) {
+        *c++ = 'Q';
+    }
+    if (board->castling & CASTLE_BLACK_KING) {
+        *c++ = 'k';
+    }
+    if (board->castling & CASTLE_BLACK_QUEEN) {
+        *c++ = 'q';
+    }
+    *c++ = ' ';
+    if (board->epSquare == NO_SQUARE) {
+        *c++ = '-';
+    } else {
+        *c++ = 'a' + SQUARE_COL(board->epSquare);
+        *c++ = '8' - SQUARE_ROW(board->epSquare);
+    }
+    *c++ = ' ';
+    c = writeFenNumber(c, board->halfmoveClock);
+    *c++ = ' ';
+    c = writeFenNumber(c, board->fullmoveNumber);
+    *c = '\0';
+    return c - fen;
+}
+
+// Hashes the position from scratch. Only needed when a board is set up;
+// moves keep the hash up to date incrementally.
+uint64_t computeBoardHash(const struct Board *board) {
+    uint64_t hash = boardStateHash(board);
+    uint64_t bits = board->occupied;
+    while (bits) {
+        int square = popLsb(&bits);
+        hash ^= zobristPieceKeys[boardPieceAt(board, square)][square];
+    }
+    return hash;
+}
+
+void printBoard(const struct Board *board) {
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            int i = row * 8 + col;
+            printf("%d\t", boardPieceAt(board, i));
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
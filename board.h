@@ -0,0 +1,157 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "zobrist.h"
+
+/*
+The Board
+=========
+
+0  1  2  3  4  5  6  7       a8 ... h8
+8  9  10 11 12 13 14 15
+16 17 18 19 20 21 22 23
+24 25 26 27 28 29 30 31
+32 33 34 35 36 37 38 39
+40 41 42 43 44 45 46 47
+48 49 50 51 52 53 54 55
+56 57 58 59 60 61 62 63      a1 ... h1
+
+Square n is bit n of every bitboard. Row 0 is black's back rank.
+
+*/
+
+// The low 3 bits of a piece are its enum PieceType, bit 3 is its enum Color.
+// The values are also sprite indices, so they must stay in sync with the
+// piece shaders.
+enum Piece {
+    WPawn=0, WKnight, WBiship, WRook, WKing, WQueen,
+    BPawn=8, BKnight, BBiship, BRook, BKing, BQueen,
+    Blank=16
+};
+
+enum PieceType {
+    Pawn=0, Knight, Biship, Rook, King, Queen
+};
+
+enum Color {
+    White=0, Black=1
+};
+
+#define NUM_PIECE_TYPES 6
+#define PIECE_TYPE(piece) ((enum PieceType)((piece) & 7))
+#define PIECE_COLOR(piece) ((enum Color)(((piece) >> 3) & 1))
+#define MAKE_PIECE(color, type) ((enum Piece)(((color) << 3) | (type)))
+#define SQUARE_BIT(square) (1ULL << (square))
+#define SQUARE_ROW(square) ((square) >> 3)
+#define SQUARE_COL(square) ((square) & 7)
+#define NO_SQUARE -1
+#define NIBBLE_BLANK 15 // Blank in boardToNibbles, which has 4 bits per square
+
+#define CASTLE_WHITE_KING  1
+#define CASTLE_WHITE_QUEEN 2
+#define CASTLE_BLACK_KING  4
+#define CASTLE_BLACK_QUEEN 8
+#define CASTLE_ALL         15
+
+// Longest FEN boardToFen writes, with its 0, rounded up
+#define FEN_MAX_SIZE 128
+
+struct Board {
+    uint64_t pieceTypes[NUM_PIECE_TYPES]; // both colors, indexed by enum PieceType
+    uint64_t colors[2];                   // indexed by enum Color
+    uint64_t occupied;
+    uint8_t sideToMove;                   // enum Color
+    uint8_t castling;                     // CASTLE_* flags still available
+    int8_t epSquare;                      // square a pawn can capture onto en passant, or NO_SQUARE
+    uint8_t halfmoveClock;
+    uint16_t fullmoveNumber;
+    uint64_t hash;                        // Zobrist key, kept up to date by every change below
+};
+
+static inline int popCount(uint64_t bits) {
+    return __builtin_popcountll(bits);
+}
+
+// Index of the lowest set bit. bits must not be 0.
+static inline int lsbIndex(uint64_t bits) {
+    return __builtin_ctzll(bits);
+}
+
+// Clears the lowest set bit and returns its index. bits must not be 0.
+static inline int popLsb(uint64_t *bits) {
+    int index = __builtin_ctzll(*bits);
+    *bits &= *bits - 1;
+    return index;
+}
+
+static inline uint64_t pieceBits(const struct Board *board, enum Color color, enum PieceType type) {
+    return board->pieceTypes[type] & board->colors[color];
+}
+
+// Flips piece on square: adds it to an empty square or removes it from
+// the square it is on. The caller must know what is on the square.
+static inline void boardTogglePiece(struct Board *board, int square, enum Piece piece) {
+    uint64_t bit = SQUARE_BIT(square);
+    board->pieceTypes[PIECE_TYPE(piece)] ^= bit;
+    board->colors[PIECE_COLOR(piece)] ^= bit;
+    board->occupied ^= bit;
+    board->hash ^= zobristPieceKeys[piece][square];
+}
+
+// boardTogglePiece without the hash update, for callers that restore the
+// hash themselves.
+static inline void boardToggleBits(struct Board *board, int square, enum Piece piece) {
+    uint64_t bit = SQUARE_BIT(square);
+    board->pieceTypes[PIECE_TYPE(piece)] ^= bit;
+    board->colors[PIECE_COLOR(piece)] ^= bit;
+    board->occupied ^= bit;
+}
+
+// Whether a pawn of color stands next to the pawn that just passed over
+// square with a double push, so it could take it en passant. Boards only
+// keep an en passant square when this holds, so a position reached with
+// and without the double push has the same epSquare and hash.
+static inline bool canCaptureEnPassant(const struct Board *board, int square, enum Color color) {
+    int pushedSquare = square + (color == White ? 8 : -8);
+    uint64_t beside = 0;
+    if (SQUARE_COL(pushedSquare) > 0) {
+        beside |= SQUARE_BIT(pushedSquare - 1);
+    }
+    if (SQUARE_COL(pushedSquare) < 7) {
+        beside |= SQUARE_BIT(pushedSquare + 1);
+    }
+    return (pieceBits(board, color, Pawn) & beside) != 0;
+}
+
+// The part of the hash that is not piece placement. applyMove xors it out
+// before changing side to move, castling or en passant and back in after.
+static inline uint64_t boardStateHash(const struct Board *board) {
+    uint64_t hash = zobristCastlingKeys[board->castling];
+    if (board->epSquare != NO_SQUARE) {
+        hash ^= zobristEpKeys[SQUARE_COL(board->epSquare)];
+    }
+    if (board->sideToMove == Black) {
+        hash ^= zobristBlackToMoveKey;
+    }
+    return hash;
+}
+
+void clearBoard(struct Board *board);
+void initBoard(struct Board *board);
+enum Piece boardPieceAt(const struct Board *board, int square);
+void boardPutPiece(struct Board *board, int square, enum Piece piece);
+void boardRemovePiece(struct Board *board, int square);
+void boardMovePiece(struct Board *board, int srcPos, int destPos);
+int boardKingSquare(const struct Board *board, enum Color color);
+void boardToSquares(const struct Board *board, enum Piece squares[64]);
+void boardToNibbles(const struct Board *board, uint32_t nibbles[8]);
+const char *parseFen(struct Board *board, const char *text, const char *end);
+int boardFromFen(struct Board *board, const char *fen);
+int boardToFen(const struct Board *board, char fen[FEN_MAX_SIZE]);
+bool boardIsValid(const struct Board *board);
+uint64_t computeBoardHash(const struct Board *board);
+void printBoard(const struct Board *board);
+
+#endif
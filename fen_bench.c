@@ -0,0 +1,178 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "errors.h"
+#include "board.h"
+#include "mapped_file.h"
+
+/*
+
+FEN reader benchmark. Reads a file of positions, one FEN or EPD line each
+as test suites come, checks that every one is written back and read again
+as the same board, then times reading and writing them all.
+
+    ./build_fen_bench
+    ./fen_bench.bin [file]
+
+Without a file, the perft positions are used.
+
+*/
+
+// Passes over the positions are repeated until this many were timed
+#define MIN_TIMED_POSITIONS 2000000
+
+struct FenLine {
+    const char *text; // not 0 terminated
+    int length;
+};
+
+const char *defaultPositions =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n"
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1\n"
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1\n"
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1\n"
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8\n"
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10\n"
+    "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3\n";
+
+double currentSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Splits text into its lines, leaving out blank ones and # comments.
+int splitLines(const char *text, const char *end, struct FenLine **lines) {
+    int numLines = 0;
+    int capacity = 64;
+    *lines = malloc(capacity * sizeof(struct FenLine));
+    while (text < end) {
+        const char *lineEnd = memchr(text, '\n', end - text);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        int length = lineEnd - text;
+        if (length > 0 && text[length - 1] == '\r') {
+            length--;
+        }
+        if (length > 0 && text[0] != '#') {
+            if (numLines == capacity) {
+                capacity *= 2;
+                *lines = realloc(*lines, capacity * sizeof(struct FenLine));
+            }
+            (*lines)[numLines].text = text;
+            (*lines)[numLines].length = length;
+            numLines++;
+        }
+        text = lineEnd + 1;
+    }
+    return numLines;
+}
+
+// Reads every line into boards, and checks that writing it and reading that
+// back gives the same board. Returns how many lines failed either way.
+int checkPositions(const struct FenLine *lines, int numLines, struct Board *boards) {
+    int failures = 0;
+    for (int i = 0; i < numLines; i++) {
+        const struct FenLine *line = &lines[i];
+        char fen[FEN_MAX_SIZE];
+        struct Board again;
+        if (parseFen(&boards[i], line->text, line->text + line->length) == NULL) {
+            printf("bad FEN on line %d: %.*s\n", i + 1, line->length, line->text);
+            failures++;
+            continue;
+        }
+        int length = boardToFen(&boards[i], fen);
+        if (parseFen(&again, fen, fen + length) == NULL ||
+            memcmp(&again, &boards[i], sizeof(struct Board)) != 0) {
+            printf("MISMATCH on line %d: %.*s came back as %s\n", i + 1, line->length, line->text, fen);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+void runParsePass(const struct FenLine *lines, int numLines) {
+    uint64_t hashes = 0;
+    long positions = 0;
+    double start = currentSeconds();
+    while (positions < MIN_TIMED_POSITIONS) {
+        for (int i = 0; i < numLines; i++) {
+            struct Board board;
+            if (parseFen(&board, lines[i].text, lines[i].text + lines[i].length) != NULL) {
+                hashes += board.hash;
+            }
+        }
+        positions += numLines;
+    }
+    double seconds = currentSeconds() - start;
+    printf("parse  %8.3fs  %12.0f positions/s  (%016llx)\n",
+        seconds, positions / seconds, (unsigned long long)hashes);
+}
+
+void runWritePass(const struct Board *boards, int numBoards) {
+    size_t bytes = 0;
+    long positions = 0;
+    double start = currentSeconds();
+    while (positions < MIN_TIMED_POSITIONS) {
+        for (int i = 0; i < numBoards; i++) {
+            char fen[FEN_MAX_SIZE];
+            bytes += boardToFen(&boards[i], fen);
+        }
+        positions += numBoards;
+    }
+    double seconds = currentSeconds() - start;
+    printf("write  %8.3fs  %12.0f positions/s  %8.1f MB/s\n",
+        seconds, positions / seconds, bytes / seconds / 1e6);
+}
+
+int runBenchmark(const char *text, const char *end) {
+    struct FenLine *lines;
+    int numLines = splitLines(text, end, &lines);
+    if (numLines == 0) {
+        set_error(1, "No positions to read");
+        free(lines);
+        return 1;
+    }
+    struct Board *boards = malloc(numLines * sizeof(struct Board));
+    int failures = checkPositions(lines, numLines, boards);
+    printf("%d position(s), %d failed\n", numLines, failures);
+    runParsePass(lines, numLines);
+    // Failed lines are left out of the write pass
+    int numBoards = 0;
+    for (int i = 0; i < numLines; i++) {
+        struct Board board;
+        if (parseFen(&board, lines[i].text, lines[i].text + lines[i].length) != NULL) {
+            boards[numBoards++] = board;
+        }
+    }
+    if (numBoards > 0) {
+        runWritePass(boards, numBoards);
+    }
+    free(boards);
+    free(lines);
+    return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 1) {
+        return runBenchmark(defaultPositions, defaultPositions + strlen(defaultPositions));
+    }
+    struct MappedFile file;
+    if (mapFile(argv[1], &file) != 0) {
+        finalize_error();
+        return 1;
+    }
+    int status = runBenchmark(file.data, file.data + file.size);
+    unmapFile(&file);
+    if (status != 0) {
+        finalize_error();
+    }
+    return status;
+}
@@ -0,0 +1,238 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+
+/*
+
+Writes attack_tables.h: the knight, king and pawn attack sets and the
+sliding piece lookup tables used by movegen.c, so nothing is computed at
+startup. The build scripts run this before compiling.
+
+    gcc -O2 gen_attack_tables.c -o gen_attack_tables.bin
+    ./gen_attack_tables.bin > attack_tables.h
+
+Sliding attacks are stored twice over the same per-square slots: once
+ordered by magic index ((occupied & mask) * magic >> shift) and once by
+PEXT index (_pext_u64(occupied, mask)), so BMI2 can be picked at runtime.
+
+*/
+
+#define FILE_A 0x0101010101010101ULL
+#define FILE_B 0x0202020202020202ULL
+#define FILE_G 0x4040404040404040ULL
+#define FILE_H 0x8080808080808080ULL
+
+struct SliderTables {
+    char *name;      // prefix of the generated array names
+    char *macroName; // prefix of the generated size macro
+    int directions[4][2];
+    uint64_t masks[64];
+    uint64_t magics[64];
+    int shifts[64];
+    int offsets[64];
+    int size;
+    uint64_t *magicAttacks;
+    uint64_t *pextAttacks;
+};
+
+uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+uint64_t nextRandom() {
+    // xorshift64*, seeded with a constant so the output is reproducible
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 2685821657736338717ULL;
+}
+
+uint64_t sparseRandom() {
+    return nextRandom() & nextRandom() & nextRandom();
+}
+
+bool onBoard(int row, int col) {
+    return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+uint64_t slidingAttacks(struct SliderTables *tables, int square, uint64_t occupied) {
+    uint64_t attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int row = SQUARE_ROW(square) + tables->directions[d][0];
+        int col = SQUARE_COL(square) + tables->directions[d][1];
+        while (onBoard(row, col)) {
+            uint64_t bit = SQUARE_BIT(row * 8 + col);
+            attacks |= bit;
+            if (occupied & bit) {
+                break;
+            }
+            row += tables->directions[d][0];
+            col += tables->directions[d][1];
+        }
+    }
+    return attacks;
+}
+
+// Squares whose occupancy can change the attack set: the rays without
+// their last square.
+uint64_t relevantMask(struct SliderTables *tables, int square) {
+    uint64_t mask = 0;
+    for (int d = 0; d < 4; d++) {
+        int row = SQUARE_ROW(square) + tables->directions[d][0];
+        int col = SQUARE_COL(square) + tables->directions[d][1];
+        while (onBoard(row + tables->directions[d][0], col + tables->directions[d][1])) {
+            mask |= SQUARE_BIT(row * 8 + col);
+            row += tables->directions[d][0];
+            col += tables->directions[d][1];
+        }
+    }
+    return mask;
+}
+
+// The index-th subset of mask, in the order _pext_u64 numbers them.
+uint64_t depositBits(uint64_t index, uint64_t mask) {
+    uint64_t result = 0;
+    for (int bit = 0; mask; bit++) {
+        uint64_t lowest = mask & -mask;
+        if (index & (1ULL << bit)) {
+            result |= lowest;
+        }
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+void buildSquare(struct SliderTables *tables, int square, uint64_t *occupancies, uint64_t *attacks, uint64_t *scratch) {
+    uint64_t mask = tables->masks[square];
+    int bits = popCount(mask);
+    int count = 1 << bits;
+    uint64_t *pextSlots = tables->pextAttacks + tables->offsets[square];
+    uint64_t *magicSlots = tables->magicAttacks + tables->offsets[square];
+
+    for (int i = 0; i < count; i++) {
+        occupancies[i] = depositBits(i, mask);
+        attacks[i] = slidingAttacks(tables, square, occupancies[i]);
+        pextSlots[i] = attacks[i];
+    }
+
+    tables->shifts[square] = 64 - bits;
+    for (;;) {
+        uint64_t magic = sparseRandom();
+        if (popCount((mask * magic) >> 56) < 6) {
+            continue;
+        }
+        memset(scratch, 0, count * sizeof(uint64_t));
+        bool collision = false;
+        for (int i = 0; i < count && !collision; i++) {
+            uint64_t index = (occupancies[i] * magic) >> tables->shifts[square];
+            if (scratch[index] == 0) {
+                scratch[index] = attacks[i];
+            } else if (scratch[index] != attacks[i]) {
+                collision = true;
+            }
+        }
+        if (!collision) {
+            tables->magics[square] = magic;
+            memcpy(magicSlots, scratch, count * sizeof(uint64_t));
+            return;
+        }
+    }
+}
+
+void buildSliderTables(struct SliderTables *tables) {
+    tables->size = 0;
+    for (int square = 0; square < 64; square++) {
+        tables->masks[square] = relevantMask(tables, square);
+        tables->offsets[square] = tables->size;
+        tables->size += 1 << popCount(tables->masks[square]);
+    }
+    tables->magicAttacks = calloc(tables->size, sizeof(uint64_t));
+    tables->pextAttacks = calloc(tables->size, sizeof(uint64_t));
+
+    uint64_t *occupancies = malloc(4096 * sizeof(uint64_t));
+    uint64_t *attacks = malloc(4096 * sizeof(uint64_t));
+    uint64_t *scratch = malloc(4096 * sizeof(uint64_t));
+    for (int square = 0; square < 64; square++) {
+        buildSquare(tables, square, occupancies, attacks, scratch);
+    }
+    free(occupancies);
+    free(attacks);
+    free(scratch);
+}
+
+void printTable(char *type, char *name, uint64_t *values, int count) {
+    printf("static const %s %s[%d] = {", type, name, count);
+    for (int i = 0; i < count; i++) {
+        printf(i % 4 == 0 ? "\n    " : " ");
+        printf("0x%016llxULL,", (unsigned long long)values[i]);
+    }
+    printf("\n};\n\n");
+}
+
+void printIntTable(char *type, char *name, int *values, int count) {
+    printf("static const %s %s[%d] = {", type, name, count);
+    for (int i = 0; i < count; i++) {
+        printf(i % 8 == 0 ? "\n    " : " ");
+        printf("%d,", values[i]);
+    }
+    printf("\n};\n\n");
+}
+
+void printSliderTables(struct SliderTables *tables) {
+    char name[64];
+    printf("#define %s_ATTACK_TABLE_SIZE %d\n\n", tables->macroName, tables->size);
+    snprintf(name, sizeof(name), "%sMasks", tables->name);
+    printTable("uint64_t", name, tables->masks, 64);
+    snprintf(name, sizeof(name), "%sMagics", tables->name);
+    printTable("uint64_t", name, tables->magics, 64);
+    snprintf(name, sizeof(name), "%sShifts", tables->name);
+    printIntTable("uint8_t", name, tables->shifts, 64);
+    snprintf(name, sizeof(name), "%sOffsets", tables->name);
+    printIntTable("uint32_t", name, tables->offsets, 64);
+    snprintf(name, sizeof(name), "%sMagicAttacks", tables->name);
+    printTable("uint64_t", name, tables->magicAttacks, tables->size);
+    snprintf(name, sizeof(name), "%sPextAttacks", tables->name);
+    printTable("uint64_t", name, tables->pextAttacks, tables->size);
+}
+
+void printStepperTables() {
+    uint64_t knights[64], kings[64], whitePawns[64], blackPawns[64];
+    for (int square = 0; square < 64; square++) {
+        uint64_t bit = SQUARE_BIT(square);
+        uint64_t oneColumn = ((bit >> 1) & ~FILE_H) | ((bit << 1) & ~FILE_A);
+        uint64_t twoColumns = ((bit >> 2) & ~(FILE_G | FILE_H)) | ((bit << 2) & ~(FILE_A | FILE_B));
+        knights[square] = (oneColumn << 16) | (oneColumn >> 16) | (twoColumns << 8) | (twoColumns >> 8);
+
+        uint64_t row = bit | oneColumn;
+        kings[square] = (row | (row << 8) | (row >> 8)) & ~bit;
+
+        // White pawns move towards row 0
+        whitePawns[square] = ((bit & ~FILE_A) >> 9) | ((bit & ~FILE_H) >> 7);
+        blackPawns[square] = ((bit & ~FILE_A) << 7) | ((bit & ~FILE_H) << 9);
+    }
+    printTable("uint64_t", "knightAttackTable", knights, 64);
+    printTable("uint64_t", "kingAttackTable", kings, 64);
+    printTable("uint64_t", "whitePawnAttackTable", whitePawns, 64);
+    printTable("uint64_t", "blackPawnAttackTable", blackPawns, 64);
+}
+
+int main() {
+    struct SliderTables rook = {
+        .name = "rook", .macroName = "ROOK",
+        .directions = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} }
+    };
+    struct SliderTables bishop = {
+        .name = "bishop", .macroName = "BISHOP",
+        .directions = { {-1, -1}, {-1, 1}, {1, -1}, {1, 1} }
+    };
+    buildSliderTables(&rook);
+    buildSliderTables(&bishop);
+
+    printf("// Generated by gen_attack_tables.c. Do not edit.\n\n");
+    printf("#include <stdint.h>\n\n");
+    printStepperTables();
+    printSliderTables(&rook);
+    printSliderTables(&bishop);
+    return 0;
+}
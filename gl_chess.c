@@ -4,12 +4,25 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include <math.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <stddef.h>
+#include <sys/stat.h>
 #include "errors.h"
+#include "log.h"
 #include "read_file.h"
 #include "utarray.h"
+#include "board.h"
+#include "movegen.h"
+#include "timeline.h"
+#include "stream_buffer.h"
+#include "thumbnail_atlas.h"
+#include "program_cache.h"
+#include "texture_loader.h"
+#include "pgn.h"
+#include "pgn_index.h"
+#include "journal.h"
 
 #define WINDOW_WIDTH 720
 #define WINDOW_HEIGHT 720
@@ -19,27 +32,44 @@
 #define TIMELINE_GAP 0.1
 #define ANIMATION_DURATION 40
 #define TIME_MARKER_WIDTH 2
+#define TRANSPOSITION_MARK_HEIGHT 3
+#define SPRITE_COLUMNS 7 // sprite.png is a grid of this many pieces across
+#define SPRITE_ROWS 2    // and this many down
+#define NUM_SPRITE_CODES (NIBBLE_BLANK + 1)
+#define BENCHMARK_BOARDS_ACROSS 32 // the benchmark draws this many squared
+#define BENCHMARK_WARMUP_FRAMES 20
+#define BENCHMARK_FRAMES 200
+
+// What has to be redrawn. The whole window is redrawn when anything is
+// dirty, but the timeline is only walked again when DIRTY_TIMELINE is set.
+#define DIRTY_MAIN_BOARD  1
+#define DIRTY_TIMELINE    2
+#define DIRTY_TIME_MARKER 4
+#define DIRTY_ALL         7
 
-enum Piece {
-    WPawn=0, WKnight, WBiship, WRook, WKing, WQueen,
-    BPawn=8, BKnight, BBiship, BRook, BKing, BQueen,
-    Blank=16
-};
-
-struct Board {
-    enum Piece squares[64];
+struct BoardView {
+    GLfloat x;
+    GLfloat y;
+    GLfloat size;
 };
 
-struct BoardView {
+// Per instance data for drawing a board and its pieces. The first three
+// fields are a struct BoardView.
+struct BoardInstance {
     GLfloat x;
     GLfloat y;
     GLfloat size;
+    GLuint squares[8]; // see boardToNibbles
 };
 
-struct TimelineNode {
-    struct TimelineNode *parent;
-    UT_array *snapshots; // array of struct Board's
-    UT_array *children;   // array of struct TimelineNode's
+// Per instance data for drawing a thumbnail from the atlas. The first
+// three fields are a struct BoardView.
+struct ThumbnailInstance {
+    GLfloat x;
+    GLfloat y;
+    GLfloat size;
+    GLfloat texLeft;
+    GLfloat texTop;
 };
 
 struct TimelineViewNode {
@@ -48,30 +78,87 @@ struct TimelineViewNode {
     GLfloat width;
     GLfloat height;
     struct TimelineNode *timeline;
-    UT_array *children; // array of struct TimelineViewNode's
+};
+
+// How board_checker_fragment_shader.glsl draws the board background.
+struct CheckerBoardStyle {
+    GLfloat lightColor[4];
+    GLfloat darkColor[4];
+    bool coordinates;
+};
+
+const struct CheckerBoardStyle defaultCheckerBoardStyle = {
+    { 0.91, 0.76, 0.54, 1.0 },
+    { 0.71, 0.42, 0.17, 1.0 },
+    true
 };
 
 struct GLSettings {
+    // Quads are expanded from gl_VertexID in the vertex shader rather than
+    // from points in a geometry shader (see drawQuads)
+    bool vertexQuads;
+    // The board background is drawn by a shader rather than from board.png
+    bool checkerBoard;
+    struct CheckerBoardStyle checkerBoardStyle;
     GLuint boardProgram;
     GLuint piecesProgram;
+    GLuint thumbnailProgram;
     GLuint timeMarkerProgram;
     GLuint timeMarkerPerspectiveUniformId;
-    GLuint boardTextureId;
+    GLint  timeMarkerColorUniform;
+    struct TextureLoad boardTexture;
     GLuint boardTexUniformId;
     GLuint boardPerspectiveUniformId;
-    GLuint piecesTextureId;
+    GLint  boardLightColorUniform;
+    GLint  boardDarkColorUniform;
+    GLint  boardShowCoordinatesUniform;
+    struct TextureLoad piecesTexture;
     GLuint piecesTexUniformId;
     GLuint piecesPerspectiveUniformId;
-    GLint  boardSizeUniform;
-    GLint  boardTopLeftUniform;
     GLint  overrideIDUniform;
+    GLint  pieceSpritesUniform;
+    GLint  spriteSizeUniform;
     GLint  overridePositionUniform;
     GLuint boardVertexArrayId;
-    GLuint boardVertexBufferId;
     GLuint piecesVertexArrayId;
-    GLuint piecesVertexBufferId;
+    GLint  boardVertexAttr;
+    GLint  boardSizeAttr;
+    GLint  piecesBoardTopLeftAttr;
+    GLint  piecesBoardSizeAttr;
+    GLint  piecesSquares0Attr;
+    GLint  piecesSquares1Attr;
+    GLuint transpositionMarkVertexArrayId;
+    GLint  timeMarkerPosAttr;
+    GLuint thumbnailVertexArrayId;
+    GLint  thumbnailVertexAttr;
+    GLint  thumbnailSizeAttr;
+    GLint  thumbnailTexTopLeftAttr;
+    GLuint thumbnailPerspectiveUniformId;
+    GLuint thumbnailTexUniformId;
+    GLint  thumbnailTexSizeUniform;
+    struct ThumbnailAtlas atlas;
+    struct StreamBuffer streamBuffer; // all geometry that changes per frame
     GLuint timeMarkerVertexArrayId;
-    GLuint timeMarkerBufferId;
+};
+
+// Where a piece is in sprite.png, in grid cells.
+struct SpriteCell {
+    int column;
+    int row;
+    bool drawn;
+};
+
+// Indexed by enum Piece. Codes that are not a piece, Blank among them,
+// draw nothing. Changing the piece set only takes a new sprite.png and
+// this table; the shader looks it up (see uploadPieceSprites). Until
+// build_bake bakes it again, sprite.png is drawn as it is.
+const struct SpriteCell pieceSprites[NUM_SPRITE_CODES] = {
+    [WPawn]   = { 1, 1, true }, [WKnight] = { 2, 1, true },
+    [WBiship] = { 3, 1, true }, [WRook]   = { 4, 1, true },
+    [WKing]   = { 5, 1, true }, [WQueen]  = { 6, 1, true },
+    [BPawn]   = { 1, 0, true }, [BKnight] = { 2, 0, true },
+    [BBiship] = { 3, 0, true }, [BRook]   = { 4, 0, true },
+    [BKing]   = { 5, 0, true }, [BQueen]  = { 6, 0, true },
 };
 
 struct TimeMarkerAnimation {
@@ -82,17 +169,25 @@ struct TimeMarkerAnimation {
     int currentTick;
 };
 
+UT_icd board_instance_icd = { sizeof(struct BoardInstance), NULL, NULL, NULL };
+UT_icd thumbnail_instance_icd = { sizeof(struct ThumbnailInstance), NULL, NULL, NULL };
+UT_icd vertex_icd = { 2 * sizeof(GLfloat), NULL, NULL, NULL };
+
 struct Board mainBoard;
+UT_array *mainBoardHistory; // struct UndoEntry's made since mainBoard was set from the timeline
 struct BoardView mainBoardView;
 
-UT_icd board_icd = { sizeof(struct Board), NULL, NULL, NULL };
-UT_icd timeline_view_icd = { sizeof(struct TimelineViewNode), NULL, NULL };
-
 struct GLSettings glSettings;
 struct TimelineNode *rootTimeline = NULL;
+struct PgnIndex pgnIndex; // of the file --game opened a game from
+struct Journal journal = { .fd = -1 }; // of --session
 struct TimelineNode *currTimeline = NULL;
-struct TimelineViewNode timelineView;
-struct TimelineViewNode *currTimelineView = NULL;
+GLfloat timelinePlyWidth;  // pixels per ply, so the longest path fits the window
+GLfloat timelineRowHeight; // pixels per row of branches
+UT_array *thumbnailInstances;        // struct ThumbnailInstance's, refilled every frame
+UT_array *atlasMissInstances;        // struct BoardInstance's to draw into the atlas this frame
+UT_array *uncachedInstances;         // struct BoardInstance's drawn directly, when the atlas is full
+UT_array *transpositionMarkVertices; // pairs of GLfloat's, refilled every frame
 int currentTimestamp = 0; // TODO: rename to currentSnapshot?
 GLfloat timeMarkerVertices[8];
 int draggingTimeMarker = 0;
@@ -100,6 +195,7 @@ int draggingSquare = -1;
 GLfloat draggingPieceX;
 GLfloat draggingPieceY;
 struct TimeMarkerAnimation timeMarkerAnimation;
+unsigned dirtyRegions = DIRTY_ALL;
 
 const GLfloat perspectiveMatrix[16] = {
     2.0 / WINDOW_WIDTH, 0, 0, -1, 
@@ -108,6 +204,20 @@ const GLfloat perspectiveMatrix[16] = {
     0, 0, 0, 1
 };
 
+// Atlas pixels to the atlas framebuffer. Unlike perspectiveMatrix y is
+// not flipped, so a board drawn at atlas y has its top row at texture
+// coordinate y / ATLAS_SIZE, which is how the quads sample textures.
+const GLfloat atlasMatrix[16] = {
+    2.0 / ATLAS_SIZE, 0, 0, -1,
+    0, 2.0 / ATLAS_SIZE, 0, -1,
+    0, 0, 1, 0,
+    0, 0, 0, 1
+};
+
+void markDirty(unsigned regions) {
+    dirtyRegions |= regions;
+}
+
 void displayGLVersions() {
     printf("OpenGL version: %s\n", glGetString(GL_VERSION));
     printf("GLSL version: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
@@ -140,77 +250,6 @@ int compileShader(char *shaderSource, GLenum shaderType, GLuint *shaderId) {
     return 0;
 }
 
-GLenum textureFormat(int channels) {
-    return GL_RGBA;
-    GLenum result;
-    switch (channels) {
-        case 1: result = GL_LUMINANCE;
-        case 2: result = GL_LUMINANCE_ALPHA;
-        case 3: result = GL_RGB;
-        case 4: result = GL_RGBA;
-        default: result = -1;
-    }
-    printf("textureFormat is %d\n", result);
-    return result;
-}
-
-/*
-The Board
-=========
-
-0  1  2  3  4  5  6  7
-8  9  10 11 12 13 14 15
-16 17 18 19 20 21 22 23
-24 25 26 27 28 29 30 31
-32 33 34 35 36 37 38 39
-40 41 42 43 44 45 46 47
-48 49 50 51 52 53 54 55
-56 57 58 59 60 61 62 63
-
-*/
-
-void initBoard(struct Board *board) {
-    
-    for (int i = 0; i < 64; i++) {
-        board->squares[i] = Blank;
-    }
-    
-    board->squares[0] = BRook;
-    board->squares[1] = BKnight;
-    board->squares[2] = BBiship;
-    board->squares[3] = BQueen;
-    board->squares[4] = BKing;
-    board->squares[5] = BBiship;
-    board->squares[6] = BKnight;
-    board->squares[7] = BRook;
-    board->squares[8] = BPawn;
-    board->squares[9] = BPawn;
-    board->squares[10] = BPawn;
-    board->squares[11] = BPawn;
-    board->squares[12] = BPawn;
-    board->squares[13] = BPawn;
-    board->squares[14] = BPawn;
-    board->squares[15] = BPawn;
-    
-    board->squares[48] = WPawn;
-    board->squares[49] = WPawn;
-    board->squares[50] = WPawn;
-    board->squares[51] = WPawn;
-    board->squares[52] = WPawn;
-    board->squares[53] = WPawn;
-    board->squares[54] = WPawn;
-    board->squares[55] = WPawn;
-    board->squares[56] = WRook;
-    board->squares[57] = WKnight;
-    board->squares[58] = WBiship;
-    board->squares[59] = WQueen;
-    board->squares[60] = WKing;
-    board->squares[61] = WBiship;
-    board->squares[62] = WKnight;
-    board->squares[63] = WRook;
-    
-}
-
 GLfloat max(GLfloat a, GLfloat b) {
     if (a > b) {
         return a;
@@ -227,176 +266,332 @@ GLfloat min(GLfloat a, GLfloat b) {
     }
 }
 
-void printBoard(struct Board *board) {
-    for (int row = 0; row < 8; row++) {
-        for (int col = 0; col < 8; col++) {
-            int i = row * 8 + col;
-            printf("%d\t", board->squares[i]);
-        }
-        printf("\n");
-    }
-    printf("\n");
-}
-
-struct TimelineNode *newTimeline(struct TimelineNode *parent) {
-    struct TimelineNode *tl = malloc(sizeof(struct TimelineNode));
-    tl->parent = parent;
-    utarray_new(tl->snapshots, &board_icd);
-    utarray_new(tl->children, &timeline_view_icd);
-    return tl;
-}
-
-void initBuffers(
+// Vertex arrays only get their attributes enabled here. Where they read
+// from is set for each draw, since everything drawn comes from the
+// stream buffer at a different offset each time.
+int initBuffers(
     struct GLSettings *glSettings) {
     GLuint piecesProgram = glSettings->piecesProgram;
     GLuint boardProgram = glSettings->boardProgram;
+    
+    CALL(initStreamBuffer(&glSettings->streamBuffer, STREAM_BUFFER_INITIAL_SIZE));
         
-    // Init pieces vertex array and vertex buffer
+    // Init pieces vertex array: 64 quads per instance, one per square
     glGenVertexArrays(1, &glSettings->piecesVertexArrayId);
     glBindVertexArray(glSettings->piecesVertexArrayId);
-    glGenBuffers(1, &glSettings->piecesVertexBufferId);
-    glBindBuffer(GL_ARRAY_BUFFER, glSettings->piecesVertexBufferId);
-    
-    GLint spriteTypeAttr = glGetAttribLocation(piecesProgram, "spriteType");
-    glEnableVertexAttribArray(spriteTypeAttr);
-    glVertexAttribIPointer(spriteTypeAttr, 1, GL_INT, sizeof(enum Piece), NULL);
+    glSettings->piecesBoardTopLeftAttr = glGetAttribLocation(piecesProgram, "boardTopLeft");
+    glSettings->piecesBoardSizeAttr = glGetAttribLocation(piecesProgram, "boardSize");
+    glSettings->piecesSquares0Attr = glGetAttribLocation(piecesProgram, "squares0");
+    glSettings->piecesSquares1Attr = glGetAttribLocation(piecesProgram, "squares1");
+    GLint piecesAttrs[4] = {
+        glSettings->piecesBoardTopLeftAttr, glSettings->piecesBoardSizeAttr,
+        glSettings->piecesSquares0Attr, glSettings->piecesSquares1Attr
+    };
+    for (int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(piecesAttrs[i]);
+        glVertexAttribDivisor(piecesAttrs[i], 1);
+    }
     
-    glSettings->boardSizeUniform = glGetUniformLocation(piecesProgram, "boardSize");
-    glSettings->boardTopLeftUniform = glGetUniformLocation(piecesProgram, "boardTopLeft");
     glSettings->overrideIDUniform = glGetUniformLocation(piecesProgram, "overrideID");
     glSettings->overridePositionUniform = glGetUniformLocation(piecesProgram, "overridePosition");
     
-    // Init board vertex array and vertex buffer
+    // Init board vertex array: 1 quad per instance
     glGenVertexArrays(1, &glSettings->boardVertexArrayId);
     glBindVertexArray(glSettings->boardVertexArrayId);
-    glGenBuffers(1, &glSettings->boardVertexBufferId);
-    glBindBuffer(GL_ARRAY_BUFFER, glSettings->boardVertexBufferId);
-
-    GLint boardVertexAttr = glGetAttribLocation(boardProgram, "vertex");
-    GLint boardSizeAttr = glGetAttribLocation(boardProgram, "size");
-    glEnableVertexAttribArray(boardVertexAttr);
-    glVertexAttribPointer(boardVertexAttr, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), NULL);
-    glEnableVertexAttribArray(boardSizeAttr);
-    glVertexAttribPointer(boardSizeAttr, 1, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (const GLvoid*)(2 * sizeof(GLfloat)));
+    glSettings->boardVertexAttr = glGetAttribLocation(boardProgram, "vertex");
+    glSettings->boardSizeAttr = glGetAttribLocation(boardProgram, "size");
+    glEnableVertexAttribArray(glSettings->boardVertexAttr);
+    glVertexAttribDivisor(glSettings->boardVertexAttr, 1);
+    glEnableVertexAttribArray(glSettings->boardSizeAttr);
+    glVertexAttribDivisor(glSettings->boardSizeAttr, 1);
     
-    // Init time marker vertex array and vertex buffer
+    // Init time marker and transposition mark vertex arrays, both drawn
+    // with the time marker program
+    glSettings->timeMarkerPosAttr = glGetAttribLocation(glSettings->timeMarkerProgram, "pos");
     glGenVertexArrays(1, &glSettings->timeMarkerVertexArrayId);
     glBindVertexArray(glSettings->timeMarkerVertexArrayId);
-    glGenBuffers(1, &glSettings->timeMarkerBufferId);
-    glBindBuffer(GL_ARRAY_BUFFER, glSettings->timeMarkerBufferId);
+    glEnableVertexAttribArray(glSettings->timeMarkerPosAttr);
+    glGenVertexArrays(1, &glSettings->transpositionMarkVertexArrayId);
+    glBindVertexArray(glSettings->transpositionMarkVertexArrayId);
+    glEnableVertexAttribArray(glSettings->timeMarkerPosAttr);
     
-    GLint posAttr = glGetAttribLocation(glSettings->timeMarkerProgram, "pos");
-    glEnableVertexAttribArray(posAttr);
-    glVertexAttribPointer(posAttr, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), NULL);
+    // Init thumbnail vertex array: 1 quad per instance
+    glGenVertexArrays(1, &glSettings->thumbnailVertexArrayId);
+    glBindVertexArray(glSettings->thumbnailVertexArrayId);
+    glSettings->thumbnailVertexAttr = glGetAttribLocation(glSettings->thumbnailProgram, "vertex");
+    glSettings->thumbnailSizeAttr = glGetAttribLocation(glSettings->thumbnailProgram, "size");
+    glSettings->thumbnailTexTopLeftAttr = glGetAttribLocation(glSettings->thumbnailProgram, "texTopLeft");
+    GLint thumbnailAttrs[3] = {
+        glSettings->thumbnailVertexAttr, glSettings->thumbnailSizeAttr,
+        glSettings->thumbnailTexTopLeftAttr
+    };
+    for (int i = 0; i < 3; i++) {
+        glEnableVertexAttribArray(thumbnailAttrs[i]);
+        glVertexAttribDivisor(thumbnailAttrs[i], 1);
+    }
+    
+    CALL(initThumbnailAtlas(&glSettings->atlas));
+    return 0;
 }
 
-void updatePiecesBuffer(struct GLSettings *glSettings, struct Board *board) {
-    glBindBuffer(GL_ARRAY_BUFFER, glSettings->piecesVertexBufferId);
-    glBufferData(GL_ARRAY_BUFFER, 64 * sizeof(enum Piece), board, GL_STATIC_DRAW);
+// Points the board and pieces vertex arrays at struct BoardInstance's
+// starting at offset in the stream buffer.
+void pointBoardInstanceAttributes(struct GLSettings *glSettings, GLintptr offset) {
+    GLsizei stride = sizeof(struct BoardInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, glSettings->streamBuffer.bufferId);
+    
+    glBindVertexArray(glSettings->piecesVertexArrayId);
+    glVertexAttribPointer(glSettings->piecesBoardTopLeftAttr, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct BoardInstance, x)));
+    glVertexAttribPointer(glSettings->piecesBoardSizeAttr, 1, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct BoardInstance, size)));
+    glVertexAttribIPointer(glSettings->piecesSquares0Attr, 4, GL_UNSIGNED_INT, stride, (const GLvoid*)(offset + offsetof(struct BoardInstance, squares)));
+    glVertexAttribIPointer(glSettings->piecesSquares1Attr, 4, GL_UNSIGNED_INT, stride, (const GLvoid*)(offset + offsetof(struct BoardInstance, squares[4])));
+    
+    glBindVertexArray(glSettings->boardVertexArrayId);
+    glVertexAttribPointer(glSettings->boardVertexAttr, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct BoardInstance, x)));
+    glVertexAttribPointer(glSettings->boardSizeAttr, 1, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct BoardInstance, size)));
 }
 
-void updateBoardBuffer(struct GLSettings *glSettings, struct BoardView *boardView) {
-    glBindBuffer(GL_ARRAY_BUFFER, glSettings->boardVertexBufferId);
-    glBufferData(GL_ARRAY_BUFFER, 3 * sizeof(GLfloat), boardView, GL_STATIC_DRAW);
+// Uploads count 2D vertices and binds vertexArrayId to read them.
+void streamVertices(struct GLSettings *glSettings, GLuint vertexArrayId, GLfloat *vertices, int count) {
+    GLsizeiptr size = count * 2 * sizeof(GLfloat);
+    GLintptr offset = streamUpload(&glSettings->streamBuffer, vertices, size, 2 * sizeof(GLfloat));
+    glBindVertexArray(vertexArrayId);
+    glBindBuffer(GL_ARRAY_BUFFER, glSettings->streamBuffer.bufferId);
+    glVertexAttribPointer(glSettings->timeMarkerPosAttr, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (const GLvoid*)offset);
 }
 
-int compileProgram(char *vertexShaderFile, char *geometryShaderFile, char *fragmentShaderFile) {
-    GLuint program = glCreateProgram();
-    
-    char *vertexShaderSource;
-    CALL(readFile(vertexShaderFile, &vertexShaderSource));
-    GLuint vertexShaderId;
-    CALL(compileShader(vertexShaderSource, GL_VERTEX_SHADER, &vertexShaderId));
-    glAttachShader(program, vertexShaderId);
-    
-    if (geometryShaderFile) { // Geometry shader is optional
-        char *geometryShaderSource;
-        CALL(readFile(geometryShaderFile, &geometryShaderSource));
-        GLuint geometryShaderId;
-        CALL(compileShader(geometryShaderSource, GL_GEOMETRY_SHADER, &geometryShaderId));
-        glAttachShader(program, geometryShaderId);
+void updateThumbnailInstanceBuffer(struct GLSettings *glSettings, struct ThumbnailInstance *instances, int count) {
+    GLsizei stride = sizeof(struct ThumbnailInstance);
+    GLintptr offset = streamUpload(&glSettings->streamBuffer, instances, count * stride, stride);
+    glBindBuffer(GL_ARRAY_BUFFER, glSettings->streamBuffer.bufferId);
+    glBindVertexArray(glSettings->thumbnailVertexArrayId);
+    glVertexAttribPointer(glSettings->thumbnailVertexAttr, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct ThumbnailInstance, x)));
+    glVertexAttribPointer(glSettings->thumbnailSizeAttr, 1, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct ThumbnailInstance, size)));
+    glVertexAttribPointer(glSettings->thumbnailTexTopLeftAttr, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(offset + offsetof(struct ThumbnailInstance, texLeft)));
+}
+
+void setBoardInstance(struct BoardInstance *instance, struct BoardView *boardView, struct Board *board) {
+    instance->x = boardView->x;
+    instance->y = boardView->y;
+    instance->size = boardView->size;
+    boardToNibbles(board, instance->squares);
+}
+
+void updateBoardInstanceBuffer(struct GLSettings *glSettings, struct BoardInstance *instances, int count) {
+    GLsizeiptr size = count * sizeof(struct BoardInstance);
+    GLintptr offset = streamUpload(&glSettings->streamBuffer, instances, size, sizeof(struct BoardInstance));
+    pointBoardInstanceAttributes(glSettings, offset);
+}
+
+// Links the program made of the given shaders into *program. The
+// geometry shader is optional and may be NULL. The program binary cache is
+// tried first, keyed by the shader sources.
+int compileProgram(
+    char *vertexShaderFile, char *geometryShaderFile, char *fragmentShaderFile,
+    GLuint *program
+) {
+    char *files[3] = { vertexShaderFile, geometryShaderFile, fragmentShaderFile };
+    GLenum shaderTypes[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+    char *sources[3] = { NULL, NULL, NULL };
+    for (int i = 0; i < 3; i++) {
+        if (files[i]) { // Geometry shader is optional
+            CALL(readFile(files[i], &sources[i]));
+        }
     }
+    uint64_t cacheKey = programCacheKey(sources, 3);
+    *program = glCreateProgram();
     
-    char *fragmentShaderSource;
-    CALL(readFile(fragmentShaderFile, &fragmentShaderSource));
-    GLuint fragmentShaderId;
-    CALL(compileShader(fragmentShaderSource, GL_FRAGMENT_SHADER, &fragmentShaderId));
-    glAttachShader(program, fragmentShaderId);
-    
-    glLinkProgram(program);
+    if (!loadCachedProgram(cacheKey, *program)) {
+        GLuint shaderIds[3] = { 0, 0, 0 };
+        for (int i = 0; i < 3; i++) {
+            if (sources[i]) {
+                CALL(compileShader(sources[i], shaderTypes[i], &shaderIds[i]));
+                glAttachShader(*program, shaderIds[i]);
+            }
+        }
+        prepareProgramForCache(*program);
+        glLinkProgram(*program);
+        for (int i = 0; i < 3; i++) {
+            if (shaderIds[i]) {
+                glDetachShader(*program, shaderIds[i]);
+                glDeleteShader(shaderIds[i]);
+            }
+        }
+        
+        GLint linked;
+        glGetProgramiv(*program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char message[1024];
+            GLsizei length;
+            glGetProgramInfoLog(*program, 1024, &length, message);
+            set_error(1, "Link program %s failed: %.*s", vertexShaderFile, length, message);
+            return 1;
+        }
+        saveCachedProgram(cacheKey, *program);
+    }
     
-    return program;
+    for (int i = 0; i < 3; i++) {
+        free(sources[i]);
+    }
+    return 0;
 }
 
-int loadTexture(char *imageFile) {
-    GLuint textureId;
-    int imageWidth, imageHeight, imageChannels;
-    unsigned char* imagePixels;
-    imagePixels = stbi_load(imageFile, &imageWidth, &imageHeight, &imageChannels, 0);
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(
-        GL_TEXTURE_2D, 0, 
-        textureFormat(imageChannels),
-        (GLsizei)imageWidth, (GLsizei)imageHeight, 
-        0, textureFormat(imageChannels),
-        GL_UNSIGNED_BYTE,
-        imagePixels);
-    stbi_image_free(imagePixels);
-    return textureId;
+// Sets the pieces program's sprite lookup table from pieceSprites: for
+// each code, the top left of its sprite in texture coordinates, and 1 if
+// it is drawn or 0 if not. Uniforms stay set on the program, so this
+// only runs once.
+void uploadPieceSprites(struct GLSettings *glSettings) {
+    GLfloat sprites[NUM_SPRITE_CODES][3];
+    for (int i = 0; i < NUM_SPRITE_CODES; i++) {
+        sprites[i][0] = (GLfloat)pieceSprites[i].column / SPRITE_COLUMNS;
+        sprites[i][1] = (GLfloat)pieceSprites[i].row / SPRITE_ROWS;
+        sprites[i][2] = pieceSprites[i].drawn ? 1.0 : 0.0;
+    }
+    glUseProgram(glSettings->piecesProgram);
+    glUniform3fv(glSettings->pieceSpritesUniform, NUM_SPRITE_CODES, &sprites[0][0]);
+    glUniform2f(glSettings->spriteSizeUniform, 1.0 / SPRITE_COLUMNS, 1.0 / SPRITE_ROWS);
 }
 
-void initGLSettings(struct GLSettings *glSettings) {
-    glSettings->piecesProgram = compileProgram(
-        "shaders/piece_vertex_shader.glsl", 
-        "shaders/piece_geometry_shader.glsl", 
-        "shaders/common_fragment_shader.glsl"
-    );
-    glSettings->boardProgram = compileProgram(
-        "shaders/board_vertex_shader.glsl", 
-        "shaders/board_geometry_shader.glsl", 
-        "shaders/common_fragment_shader.glsl"
-    );
-    glSettings->timeMarkerProgram = compileProgram("shaders/time_marker_vertex_shader.glsl", NULL, "shaders/time_marker_fragment_shader.glsl");
+// Shown until the images have been decoded
+const GLubyte boardPlaceholder[4] = { 181, 136, 99, 255 };
+const GLubyte piecesPlaceholder[4] = { 0, 0, 0, 0 };
+
+// Whether sprite.ktx has been baked by build_bake since sprite.png last
+// changed.
+bool bakedSpritesCurrent() {
+    struct stat baked, source;
+    if (stat("sprite.ktx", &baked) != 0) {
+        return false;
+    }
+    if (stat("sprite.png", &source) == 0 && baked.st_mtime < source.st_mtime) {
+        LOG_WARN(LOG_RENDER, "sprite.ktx is older than sprite.png, drawing sprite.png until build_bake is run");
+        return false;
+    }
+    return true;
+}
+
+int initGLSettings(struct GLSettings *glSettings) {
+    // Decoding goes on while the programs compile
+    if (!glSettings->checkerBoard) {
+        CALL(startTextureLoad(&glSettings->boardTexture, "board.png", boardPlaceholder, glfwPostEmptyEvent));
+    }
+    // Prefer the sprites baked by build_bake, if they are up to date
+    char *spriteFile = bakedTexturesSupported() && bakedSpritesCurrent() ? "sprite.ktx" : "sprite.png";
+    CALL(startTextureLoad(&glSettings->piecesTexture, spriteFile, piecesPlaceholder, glfwPostEmptyEvent));
+    char *boardFragmentShader = glSettings->checkerBoard
+        ? "shaders/board_checker_fragment_shader.glsl"
+        : "shaders/common_fragment_shader.glsl";
+    if (glSettings->vertexQuads) {
+        CALL(compileProgram(
+            "shaders/piece_quad_vertex_shader.glsl",
+            NULL,
+            "shaders/common_fragment_shader.glsl",
+            &glSettings->piecesProgram
+        ));
+        CALL(compileProgram(
+            "shaders/board_quad_vertex_shader.glsl",
+            NULL,
+            boardFragmentShader,
+            &glSettings->boardProgram
+        ));
+        CALL(compileProgram(
+            "shaders/thumbnail_quad_vertex_shader.glsl",
+            NULL,
+            "shaders/common_fragment_shader.glsl",
+            &glSettings->thumbnailProgram
+        ));
+    } else {
+        CALL(compileProgram(
+            "shaders/piece_vertex_shader.glsl", 
+            "shaders/piece_geometry_shader.glsl", 
+            "shaders/common_fragment_shader.glsl",
+            &glSettings->piecesProgram
+        ));
+        CALL(compileProgram(
+            "shaders/board_vertex_shader.glsl", 
+            "shaders/board_geometry_shader.glsl", 
+            boardFragmentShader,
+            &glSettings->boardProgram
+        ));
+        CALL(compileProgram(
+            "shaders/thumbnail_vertex_shader.glsl",
+            "shaders/thumbnail_geometry_shader.glsl",
+            "shaders/common_fragment_shader.glsl",
+            &glSettings->thumbnailProgram
+        ));
+    }
+    CALL(compileProgram(
+        "shaders/time_marker_vertex_shader.glsl",
+        NULL,
+        "shaders/time_marker_fragment_shader.glsl",
+        &glSettings->timeMarkerProgram
+    ));
     glSettings->timeMarkerPerspectiveUniformId = glGetUniformLocation(glSettings->timeMarkerProgram, "perspective");
-    glSettings->piecesTextureId = loadTexture("sprite.png");
+    glSettings->timeMarkerColorUniform = glGetUniformLocation(glSettings->timeMarkerProgram, "color");
     glSettings->piecesTexUniformId = glGetUniformLocation(glSettings->piecesProgram, "tex");
     glSettings->piecesPerspectiveUniformId = glGetUniformLocation(glSettings->piecesProgram, "perspective");
-    glSettings->boardTextureId = loadTexture("board.png");
+    glSettings->pieceSpritesUniform = glGetUniformLocation(glSettings->piecesProgram, "pieceSprites");
+    glSettings->spriteSizeUniform = glGetUniformLocation(glSettings->piecesProgram, "spriteSize");
+    uploadPieceSprites(glSettings);
     glSettings->boardTexUniformId = glGetUniformLocation(glSettings->boardProgram, "tex");
     glSettings->boardPerspectiveUniformId = glGetUniformLocation(glSettings->boardProgram, "perspective");
+    glSettings->boardLightColorUniform = glGetUniformLocation(glSettings->boardProgram, "lightColor");
+    glSettings->boardDarkColorUniform = glGetUniformLocation(glSettings->boardProgram, "darkColor");
+    glSettings->boardShowCoordinatesUniform = glGetUniformLocation(glSettings->boardProgram, "showCoordinates");
+    if (glSettings->checkerBoard) {
+        struct CheckerBoardStyle *style = &glSettings->checkerBoardStyle;
+        glUseProgram(glSettings->boardProgram);
+        glUniform4fv(glSettings->boardLightColorUniform, 1, style->lightColor);
+        glUniform4fv(glSettings->boardDarkColorUniform, 1, style->darkColor);
+        glUniform1i(glSettings->boardShowCoordinatesUniform, style->coordinates);
+    }
+    glSettings->thumbnailPerspectiveUniformId = glGetUniformLocation(glSettings->thumbnailProgram, "perspective");
+    glSettings->thumbnailTexUniformId = glGetUniformLocation(glSettings->thumbnailProgram, "tex");
+    glSettings->thumbnailTexSizeUniform = glGetUniformLocation(glSettings->thumbnailProgram, "texSize");
+    return 0;
+}
+
+// Draws quadsPerInstance quads for each of count instances with the
+// current program and vertex array: as many points for a geometry shader
+// to expand, or two triangles each that the vertex shader places by
+// gl_VertexID.
+void drawQuads(struct GLSettings *glSettings, int quadsPerInstance, int count) {
+    if (glSettings->vertexQuads) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6 * quadsPerInstance, count);
+    } else {
+        glDrawArraysInstanced(GL_POINTS, 0, quadsPerInstance, count);
+    }
 }
 
-void renderBoard(
-    struct GLSettings *glSettings, struct BoardView *boardView,
+// Draws the first count boards of the instance buffer with two draw
+// calls. The piece on overrideId of every board is drawn at
+// overrideX, overrideY from the board's top left instead of its square.
+void renderBoards(
+    struct GLSettings *glSettings, int count, const GLfloat *perspective,
     GLint overrideId, GLfloat overrideX, GLfloat overrideY
 ) {
     
     glUseProgram(glSettings->boardProgram);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, glSettings->boardTextureId);
-    glUniform1i(glSettings->boardTexUniformId, 0);
-    glUniformMatrix4fv(glSettings->boardPerspectiveUniformId, 1, GL_TRUE, perspectiveMatrix);
+    if (!glSettings->checkerBoard) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, glSettings->boardTexture.textureId);
+        glUniform1i(glSettings->boardTexUniformId, 0);
+    }
+    glUniformMatrix4fv(glSettings->boardPerspectiveUniformId, 1, GL_TRUE, perspective);
     glBindVertexArray(glSettings->boardVertexArrayId);
-    glDrawArrays(GL_POINTS, 0, 1);
+    drawQuads(glSettings, 1, count);
     
     glUseProgram(glSettings->piecesProgram);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, glSettings->piecesTextureId);
+    glBindTexture(GL_TEXTURE_2D, glSettings->piecesTexture.textureId);
     glUniform1i(glSettings->piecesTexUniformId, 0);
-    glUniform1f(glSettings->boardSizeUniform, boardView->size);
-    glUniform2f(glSettings->boardTopLeftUniform, boardView->x, boardView->y);
     
     glUniform1i(glSettings->overrideIDUniform, overrideId);
     glUniform2f(glSettings->overridePositionUniform, overrideX, overrideY);
-    glUniformMatrix4fv(glSettings->piecesPerspectiveUniformId, 1, GL_TRUE, perspectiveMatrix);
+    glUniformMatrix4fv(glSettings->piecesPerspectiveUniformId, 1, GL_TRUE, perspective);
     
     glBindVertexArray(glSettings->piecesVertexArrayId);
-    glDrawArrays(GL_POINTS, 0, 64);
+    drawQuads(glSettings, 64, count);
 }
 
 void printIndent(int indent) {
@@ -405,298 +600,277 @@ void printIndent(int indent) {
     }
 }
 
-void printTimeline(struct TimelineNode *timeline, int indent) {
-    if (timeline == NULL) {
-        return;
-    }
-    // printIndent(indent);
-    // printf("printTimeline\n");
-    // printIndent(indent);
-    // printf("timeline=%d, snapshots=%d\n", (int)timeline, (int)timeline->snapshots);
-    int timelineLen = utarray_len(timeline->snapshots);
-    // printIndent(indent);
-    // printf("got timelineLen\n");
-    printIndent(indent);
-    for (int i = 0; i < timelineLen; i++) {
-        printf("o");
-    }
-    int numChildren = utarray_len(timeline->children);
-    if (numChildren > 0) {
-        // printIndent(indent);
-        // printf("process children\n");
-        for (int i = 0; i < numChildren; i++) {
-            struct TimelineNode *child = utarray_eltptr(timeline->children, i);
-            if (i == 0) {
-                printf("  ");
-                printTimeline(child, 0);
-            } else {
-                printTimeline(child, indent + timelineLen + 2);
-            }
-        }    
-    } else {
-        // printIndent(indent);
-        // printf("end printTimeline\n");
-        printf("\n");
+// Fills line[from, to) with c, as far as the line goes.
+void fillLine(char *line, int from, int to, char c) {
+    for (int i = from; i < to && i < LOG_MESSAGE_MAX_SIZE - 1; i++) {
+        line[i] = c;
     }
 }
 
-void printTimelineView(struct TimelineViewNode *timelineView, int level) {
-    printIndent(level);
-    printf("TLV(x=%f, y=%f, width=%f, height=%f, count=%d)\n", 
-        timelineView->x, timelineView->y,
-        timelineView->width, timelineView->height,
-        utarray_len(timelineView->timeline->snapshots)
-    );
-    if (timelineView->children == NULL) {
+// Logs the tree as rows of one "o" per ply. A first child carries on the
+// row of its parent and every other child starts a row of its own.
+void logTimeline(struct TimelineNode *timeline, char *line, int column) {
+    int end = column + timeline->length;
+    fillLine(line, column, end, 'o');
+    int numChildren = utarray_len(timeline->children);
+    if (numChildren == 0) {
+        line[end < LOG_MESSAGE_MAX_SIZE ? end : LOG_MESSAGE_MAX_SIZE - 1] = '\0';
+        LOG_DEBUG(LOG_TIMELINE, "%s", line);
         return;
     }
-    int numChildren = utarray_len(timelineView->children);
     for (int i = 0; i < numChildren; i++) {
-        printTimelineView(utarray_eltptr(timelineView->children, i), level + 1);
+        fillLine(line, i == 0 ? end : 0, end + 2, ' ');
+        logTimeline(timelineChild(timeline, i), line, end + 2);
     }
 }
 
-int getTotalTimelineLength(struct TimelineNode *timeline) {
-    if (timeline == NULL) {
-        return 0;
-    }
-    if (timeline->children == NULL) {
-        return 1;
-    }
+// Where timeline is drawn, given the ply it starts at and its row, which
+// walks of the tree add up from the offsets timeline.c keeps.
+void getTimelineView(
+    struct TimelineNode *timeline, int startPly, int row, struct TimelineViewNode *timelineView
+) {
+    timelineView->timeline = timeline;
+    timelineView->x = startPly * timelinePlyWidth;
+    timelineView->y = (GLfloat)WINDOW_HEIGHT / 2 + row * timelineRowHeight;
+    timelineView->width = timeline->length * timelinePlyWidth;
+    timelineView->height = timelineRowHeight;
+}
+
+void logTimelineView(struct TimelineNode *timeline, int startPly, int row, int level) {
+    struct TimelineViewNode timelineView;
+    getTimelineView(timeline, startPly, row, &timelineView);
+    LOG_DEBUG(LOG_LAYOUT, "%*sTLV(x=%f, y=%f, width=%f, height=%f, count=%d)", 
+        level, "",
+        timelineView.x, timelineView.y,
+        timelineView.width, timelineView.height,
+        timeline->length
+    );
     int numChildren = utarray_len(timeline->children);
-    int maxChildLength = 0;
     for (int i = 0; i < numChildren; i++) {
-        struct TimelineNode *child = utarray_eltptr(timeline->children, i);
-        int childLength = getTotalTimelineLength(child);
-        if (childLength > maxChildLength) {
-            maxChildLength = childLength;
-        }
+        struct TimelineNode *child = timelineChild(timeline, i);
+        logTimelineView(child, startPly + timeline->length, row + child->rowOffset, level + 1);
     }
-    int length = utarray_len(timeline->snapshots);
-    return length + maxChildLength;
 }
 
-int getTotalTimelineHeight(struct TimelineNode *timeline) {
-    if (timeline == NULL) {
-        return 0;
-    }
-    if (timeline->children == NULL) {
-        return 1;
+// Only the scale depends on the whole tree, and the root keeps its
+// subtree length up to date, so this is O(1).
+void layoutTimeline(struct TimelineNode *timeline) {
+    timelinePlyWidth = (GLfloat)WINDOW_WIDTH / timeline->subtreeLength;
+    timelineRowHeight = min(100, timelinePlyWidth);
+}
+
+// move is what led to board. The first ply of rootTimeline has no move
+// and is added with an all zero one.
+void addToTimeline(struct Board *board, struct Move move) {
+    LOG_DEBUG(LOG_TIMELINE, "Adding a ply after %d of %d on currTimeline", currentTimestamp, currTimeline->length);
+    journalAddPly(&journal, currTimeline, currentTimestamp, move);
+    currTimeline = addPly(&rootTimeline, currTimeline, currentTimestamp, board, move, NULL);
+    currentTimestamp = currTimeline->length - 1;
+    // The dumps walk the whole tree, so only do it when they are wanted
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_TIMELINE)) {
+        char line[LOG_MESSAGE_MAX_SIZE];
+        LOG_DEBUG(LOG_TIMELINE, "Timeline======");
+        logTimeline(rootTimeline, line, 0);
+        LOG_DEBUG(LOG_TIMELINE, "--------------");
     }
-    int numChildren = utarray_len(timeline->children);
-    if (numChildren == 0) {
-        return 1;
+    
+    layoutTimeline(rootTimeline);
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_LAYOUT)) {
+        logTimelineView(rootTimeline, 0, 0, 0);
     }
-    int sumChildrenHeight = 0;
-    for (int i = 0; i < numChildren; i++) {
-        struct TimelineNode *child = utarray_eltptr(timeline->children, i);
-        int childrenHeight = getTotalTimelineHeight(child);
-        sumChildrenHeight += childrenHeight;
+    markDirty(DIRTY_ALL);
+}
+
+// Adds the games in filename to the timeline, leaving the main board at
+// the starting position.
+int importGames(const char *filename) {
+    struct PgnImportStats stats;
+    double start = glfwGetTime();
+    CALL(importPgn(filename, &rootTimeline, &stats));
+    double seconds = glfwGetTime() - start;
+    LOG_INFO(LOG_TIMELINE, "Read %.1f MB of PGN in %.3fs (%.0f MB/s), %ld comment(s) dropped",
+        stats.bytes / 1e6, seconds, stats.bytes / 1e6 / seconds, stats.comments);
+    currTimeline = rootTimeline;
+    currentTimestamp = 0;
+    layoutTimeline(rootTimeline);
+    markDirty(DIRTY_ALL);
+    return 0;
+}
+
+// Queues a bar along the top of a thumbnail whose position is also
+// reached somewhere else in the timeline.
+void addTranspositionMark(struct BoardView *boardView) {
+    GLfloat left = boardView->x;
+    GLfloat right = boardView->x + boardView->size;
+    GLfloat top = boardView->y;
+    GLfloat bottom = boardView->y + TRANSPOSITION_MARK_HEIGHT;
+    GLfloat vertices[6][2] = {
+        { left, top }, { right, top }, { left, bottom },
+        { right, top }, { left, bottom }, { right, bottom }
+    };
+    for (int i = 0; i < 6; i++) {
+        utarray_push_back(transpositionMarkVertices, vertices[i]);
     }
-    return sumChildrenHeight;
 }
 
-void freeTimelineView(struct TimelineViewNode *node) {
-    if (node == NULL) {
+void renderTranspositionMarks() {
+    int numVertices = utarray_len(transpositionMarkVertices);
+    if (numVertices == 0) {
         return;
     }
-    
-    if (node->children != NULL) {
-        int numChildren = utarray_len(node->children);
-        for (int i = 0; i < numChildren; i++) {
-            struct TimelineViewNode *child = utarray_eltptr(node->children, i);
-            freeTimelineView(child);
-        }
-        utarray_free(node->children);
-    }
+    glUseProgram(glSettings.timeMarkerProgram);
+    glUniformMatrix4fv(glSettings.timeMarkerPerspectiveUniformId, 1, GL_TRUE, perspectiveMatrix);
+    glUniform4f(glSettings.timeMarkerColorUniform, 0.2, 0.6, 1.0, 1.0);
+    streamVertices(
+        &glSettings, glSettings.transpositionMarkVertexArrayId,
+        utarray_front(transpositionMarkVertices), numVertices
+    );
+    glDrawArrays(GL_TRIANGLES, 0, numVertices);
 }
 
-void doLayoutTimeline(
-    struct TimelineNode *timeline,
-    GLfloat offsetx, GLfloat offsety,
-    int totalLength, int totalHeight,
-    GLfloat width, GLfloat heightPerLine,
-    struct TimelineViewNode *timelineView,
-    int level
-) {
-    printIndent(level);
-    printf("doLayoutTimeline\n");
-    if (timeline == NULL) {
-        // printIndent(level);
-        // printf("Early return\n");
+// Queues a thumbnail of board, as a quad from the atlas if it has a slot
+// for it, drawing it into the slot first if the slot is new.
+void addThumbnail(struct BoardView *boardView, struct Board *board) {
+    bool fresh;
+    int slot = atlasSlotFor(&glSettings.atlas, board->hash, &fresh);
+    if (slot == -1) {
+        struct BoardInstance instance;
+        setBoardInstance(&instance, boardView, board);
+        utarray_push_back(uncachedInstances, &instance);
         return;
     }
-    if (timeline == currTimeline) {
-        printIndent(level);
-        printf("Updated currTimelineView\n");
-        currTimelineView = timelineView;
-    }
-    timelineView->timeline = timeline;
-    timelineView->children = NULL;
-    timelineView->x = offsetx;
-    int timelineLength = utarray_len(timeline->snapshots);
-    timelineView->width = ((float)timelineLength / (float)totalLength) * width;
-    int length = utarray_len(timeline->snapshots);
-    GLfloat widthPerThumbnail = min(100, timelineView->width / length);
-    GLfloat thumbnailWidth = widthPerThumbnail;
     
-    timelineView->height = thumbnailWidth;
-    timelineView->y = offsety;
-    
-    // printIndent(level);
-    // printf("has children array\n");
-    int numChildren = utarray_len(timeline->children);
-    if (numChildren == 0) {
-        // printIndent(level);
-        // printf("has no children\n");
-        return;
+    GLfloat slotX, slotY;
+    atlasSlotTopLeft(slot, &slotX, &slotY);
+    if (fresh) {
+        struct BoardView slotView;
+        slotView.x = slotX + ATLAS_SLOT_PADDING;
+        slotView.y = slotY + ATLAS_SLOT_PADDING;
+        slotView.size = ATLAS_SLOT_SIZE - 2 * ATLAS_SLOT_PADDING;
+        struct BoardInstance instance;
+        setBoardInstance(&instance, &slotView, board);
+        utarray_push_back(atlasMissInstances, &instance);
     }
-    utarray_new(timelineView->children, &timeline_view_icd);
-    // printf("Allocated timelineView->children %u\n", (unsigned)timelineView->children);
-    utarray_resize(timelineView->children, numChildren);
-    for (int i = 0; i < numChildren; i++) {
-        struct TimelineNode *child = utarray_eltptr(timeline->children, i);
-        struct TimelineViewNode *childView = utarray_eltptr(timelineView->children, i);
-        doLayoutTimeline(
-            child,
-            offsetx + timelineView->width, offsety + i * thumbnailWidth,
-            totalLength, totalHeight,
-            width, heightPerLine,
-            childView,
-            level + 1
-        );
-        
-        // printIndent(level);
-        // printf("pushed child view\n");
-    }
-    
     
+    // Sample half a texel inside the board so edges never blend with padding
+    struct ThumbnailInstance thumbnail;
+    thumbnail.x = boardView->x;
+    thumbnail.y = boardView->y;
+    thumbnail.size = boardView->size;
+    thumbnail.texLeft = (slotX + ATLAS_SLOT_PADDING + 0.5) / ATLAS_SIZE;
+    thumbnail.texTop = (slotY + ATLAS_SLOT_PADDING + 0.5) / ATLAS_SIZE;
+    utarray_push_back(thumbnailInstances, &thumbnail);
 }
 
-void layoutTimeline(struct TimelineNode *timeline) {
-    printf("layoutTimeline\n");
-
-    int length = getTotalTimelineLength(timeline);
-    int height = getTotalTimelineHeight(timeline);
-    
-    freeTimelineView(&timelineView);
-    GLfloat heightPerLine = (GLfloat)((GLfloat)WINDOW_HEIGHT / 2) / height;
-    
-    printf(
-        "layoutTimeline(totalLength=%d, totalHeight=%d, width=%d, heightPerLine=%f)\n", 
-        length, height, 4, heightPerLine
-    );
-    
-    doLayoutTimeline(
-        timeline, 0, (GLfloat)WINDOW_HEIGHT / 2, 
-        length, height,
-        WINDOW_WIDTH, 
-        heightPerLine,
-        &timelineView,
-        0
-    );
-    
-    printTimelineView(&timelineView, 0);
+// Draws the boards queued by addThumbnail into their atlas slots.
+void renderAtlasMisses() {
+    int numMisses = utarray_len(atlasMissInstances);
+    if (numMisses == 0) {
+        return;
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, glSettings.atlas.framebufferId);
+    glViewport(0, 0, ATLAS_SIZE, ATLAS_SIZE);
+    updateBoardInstanceBuffer(&glSettings, utarray_front(atlasMissInstances), numMisses);
+    renderBoards(&glSettings, numMisses, atlasMatrix, -1, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    utarray_clear(atlasMissInstances);
+    LOG_DEBUG(LOG_RENDER, "Drew %d thumbnail(s) into the atlas", numMisses);
 }
 
-void addToTimeline(struct Board *board) {
-    int timelineLength = utarray_len(currTimeline->snapshots);
-    if (timelineLength == 0 || (currentTimestamp == timelineLength - 1)) {
-        utarray_push_back(currTimeline->snapshots, board);
-        printf("Pushing to end of currTimeline, new count: %d\n", utarray_len(currTimeline->snapshots));
-        currentTimestamp = utarray_len(currTimeline->snapshots) - 1;
-    } else {
-        printf("Forking timeline. currentTimestamp = %d, timelineLength = %d\n", currentTimestamp, timelineLength);
-        // Create an alternate timeline
-        int timelineLength = utarray_len(currTimeline->snapshots);
-        struct TimelineNode *childTimeline1 = newTimeline(currTimeline);
-        for (int i = currentTimestamp + 1; i < timelineLength; i++) {
-            utarray_push_back(childTimeline1->snapshots, utarray_eltptr(currTimeline->snapshots, i));
-        }
-        utarray_resize(currTimeline->snapshots, currentTimestamp + 1);
-        utarray_push_back(currTimeline->children, childTimeline1);
-        
-        struct TimelineNode *childTimeline2 = newTimeline(currTimeline);
-        utarray_push_back(childTimeline2->snapshots, board);
-        utarray_push_back(currTimeline->children, childTimeline2);
-        currTimeline = utarray_back(currTimeline->children);
-        currentTimestamp = 0;
+void renderThumbnails() {
+    int numThumbnails = utarray_len(thumbnailInstances);
+    if (numThumbnails > 0) {
+        GLfloat texSize = (ATLAS_SLOT_SIZE - 2 * ATLAS_SLOT_PADDING - 1.0) / ATLAS_SIZE;
+        updateThumbnailInstanceBuffer(&glSettings, utarray_front(thumbnailInstances), numThumbnails);
+        glUseProgram(glSettings.thumbnailProgram);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, glSettings.atlas.textureId);
+        glUniform1i(glSettings.thumbnailTexUniformId, 0);
+        glUniform1f(glSettings.thumbnailTexSizeUniform, texSize);
+        glUniformMatrix4fv(glSettings.thumbnailPerspectiveUniformId, 1, GL_TRUE, perspectiveMatrix);
+        drawQuads(&glSettings, 1, numThumbnails);
     }
-    printf("Timeline======\n");
-    printTimeline(rootTimeline, 0);
-    printf("--------------\n");
     
-    layoutTimeline(rootTimeline);
+    int numUncached = utarray_len(uncachedInstances);
+    if (numUncached > 0) {
+        updateBoardInstanceBuffer(&glSettings, utarray_front(uncachedInstances), numUncached);
+        renderBoards(&glSettings, numUncached, perspectiveMatrix, -1, 0, 0);
+    }
 }
 
-void doRenderTimeline(struct TimelineViewNode *timelineView, int level) {
+// Queues the thumbnails of timeline and its branches.
+void doRenderTimeline(struct TimelineNode *timeline, int startPly, int row, int level) {
     // printIndent(level);
     // printf("doRenderTimeline\n");
-    struct TimelineNode *timeline = timelineView->timeline;
-    int length = utarray_len(timeline->snapshots);
-    GLfloat widthPerThumbnail = timelineView->height;
+    struct TimelineViewNode timelineView;
+    getTimelineView(timeline, startPly, row, &timelineView);
+    int length = timeline->length;
+    GLfloat widthPerThumbnail = timelineView.height;
     GLfloat thumbnailWidth = 0.96 * widthPerThumbnail;
     GLfloat thumbnailGap = 0.04 * widthPerThumbnail;
-    int numThumbnails = ceil(timelineView->width / (thumbnailWidth + thumbnailGap));
+    int numThumbnails = ceil(timelineView.width / (thumbnailWidth + thumbnailGap));
     // printIndent(level);
     // printf("doRenderTimeline(numThumbnails=%d)\n", numThumbnails);
     for (int i = 0; i < numThumbnails; i++) {
         int index = floor((float)i * length / numThumbnails);
-        struct Board *board = utarray_eltptr(timeline->snapshots, index);
+        struct Board board;
+        getTimelineBoard(timeline, index, &board);
         struct BoardView boardView;
-        boardView.x = timelineView->x + (thumbnailWidth + thumbnailGap) * i + 0.01;
-        boardView.y = timelineView->y;
+        boardView.x = timelineView.x + (thumbnailWidth + thumbnailGap) * i + 0.01;
+        boardView.y = timelineView.y;
         boardView.size = thumbnailWidth;
         // printIndent(level);
         // printf("boardView(x=%f, y=%f, size=%f)\n", boardView.x, boardView.y, boardView.size);
-        updateBoardBuffer(&glSettings, &boardView);
-        updatePiecesBuffer(&glSettings, board);
-        renderBoard(&glSettings, &boardView, -1, 0, 0);
+        addThumbnail(&boardView, &board);
+        if (isTransposition(timeline, index)) {
+            addTranspositionMark(&boardView);
+        }
     }
     // printIndent(level);
     // printf("doRenderTimeline 3\n");
     
-    if (timelineView->children != NULL) {
-        int numChildren = utarray_len(timelineView->children);
-        for (int i = 0; i < numChildren; i++) {
-            struct TimelineViewNode *childView = utarray_eltptr(timelineView->children, i);
-            doRenderTimeline(childView, level + 1);
-        }
+    int numChildren = utarray_len(timeline->children);
+    for (int i = 0; i < numChildren; i++) {
+        struct TimelineNode *child = timelineChild(timeline, i);
+        doRenderTimeline(child, startPly + length, row + child->rowOffset, level + 1);
     }
     // printIndent(level);
     // printf("doRenderTimeline 4\n");
 }
 
-void renderTimeline() {
-    int length = utarray_len(rootTimeline->snapshots);
+// Draws the timeline, walking the tree for thumbnails only if requeue is
+// set. Otherwise the ones queued last time are drawn again.
+void renderTimeline(bool requeue) {
+    int length = rootTimeline->length;
     if (length <= 1) {
         return;
     }
     
-    doRenderTimeline(&timelineView, 0);
+    if (requeue) {
+        utarray_clear(thumbnailInstances);
+        utarray_clear(uncachedInstances);
+        utarray_clear(transpositionMarkVertices);
+        beginAtlasFrame(&glSettings.atlas);
+        doRenderTimeline(rootTimeline, 0, 0, 0);
+    }
     
-    // 
-    // int numThumbnails = 4.0 / (TIMELINE_THUMBNAIL_WIDTH + TIMELINE_THUMBNAIL_GAP);
-    // for (int i = 0; i < numThumbnails; i++) {
-    //     int index = floor((float)i * length / numThumbnails);
-    //     struct Board *board = utarray_eltptr(rootTimeline->snapshots, index);
-    //     struct BoardView boardView;
-    //     boardView.x = (TIMELINE_THUMBNAIL_WIDTH + TIMELINE_THUMBNAIL_GAP) * i - 2 + 0.01;
-    //     boardView.y = -2;
-    //     boardView.size = TIMELINE_THUMBNAIL_WIDTH;
-    //     updateBoardBuffer(&glSettings, &boardView);
-    //     updatePiecesBuffer(&glSettings, board);
-    //     renderBoard(&glSettings, &boardView, -1, 0, 0);
-    // }
+    renderAtlasMisses();
+    renderThumbnails();
+    renderTranspositionMarks();
 }
 
 void renderTimeMarker() {
-    int timelineLength = utarray_len(currTimeline->snapshots);
+    int timelineLength = currTimeline->length;
     GLfloat timeMarkerGap = 0.0001;
     GLfloat x;
     if (currTimeline == rootTimeline && timelineLength <= 1) {
         return;
     }
+    struct TimelineViewNode currTimelineView;
+    getTimelineView(currTimeline, timelineStartPly(currTimeline), timelineRow(currTimeline), &currTimelineView);
     
     if (timeMarkerAnimation.endTick > 0) {
         // render tween state
@@ -707,34 +881,37 @@ void renderTimeMarker() {
     
     } else {
         if (timelineLength == 1) {
-            x = currTimelineView->x + currTimelineView->width - 1; 
+            x = currTimelineView.x + currTimelineView.width - 1; 
         } else {
-            x = currTimelineView->x + 
-                currTimelineView->width * 
+            x = currTimelineView.x + 
+                currTimelineView.width * 
                 (((float)currentTimestamp) / (float)(timelineLength - 1)) - 1;
         }
     }
     
     glUseProgram(glSettings.timeMarkerProgram);
     glUniformMatrix4fv(glSettings.timeMarkerPerspectiveUniformId, 1, GL_TRUE, perspectiveMatrix);
+    glUniform4f(glSettings.timeMarkerColorUniform, 1.0, 0.0, 0.0, 1.0);
     
     timeMarkerVertices[0] = x;
-    timeMarkerVertices[1] = currTimelineView->y;
+    timeMarkerVertices[1] = currTimelineView.y;
     timeMarkerVertices[2] = x + TIME_MARKER_WIDTH;
-    timeMarkerVertices[3] = currTimelineView->y;
+    timeMarkerVertices[3] = currTimelineView.y;
     timeMarkerVertices[4] = x;
-    timeMarkerVertices[5] = currTimelineView->y + currTimelineView->height;
+    timeMarkerVertices[5] = currTimelineView.y + currTimelineView.height;
     timeMarkerVertices[6] = x + TIME_MARKER_WIDTH;
-    timeMarkerVertices[7] = currTimelineView->y + currTimelineView->height;
+    timeMarkerVertices[7] = currTimelineView.y + currTimelineView.height;
     
-    glBindBuffer(GL_ARRAY_BUFFER, glSettings.timeMarkerBufferId);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(timeMarkerVertices), timeMarkerVertices, GL_STATIC_DRAW);
-    glBindVertexArray(glSettings.timeMarkerVertexArrayId);
+    streamVertices(&glSettings, glSettings.timeMarkerVertexArrayId, timeMarkerVertices, 4);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
+// Sets mainBoard to currentTimestamp in currTimeline. Stepping along the
+// timeline from there is a makeMove/unmakeMove on mainBoardHistory.
 void updateMainBoard() {
-    memcpy(&mainBoard, utarray_eltptr(currTimeline->snapshots, currentTimestamp), sizeof(struct Board));
+    markDirty(DIRTY_MAIN_BOARD | DIRTY_TIME_MARKER);
+    utarray_clear(mainBoardHistory);
+    getTimelineBoard(currTimeline, currentTimestamp, &mainBoard);
 }
 
 void animateTimeMarkerToTimestamp(int timestamp) {
@@ -742,7 +919,7 @@ void animateTimeMarkerToTimestamp(int timestamp) {
         return;
     }
     GLfloat srcX;
-    int timelineLength = utarray_len(currTimeline->snapshots);
+    int timelineLength = currTimeline->length;
     GLfloat timeMarkerGap = 0.0001;
     GLfloat dstX = (2 - 2 * timeMarkerGap) * (((float)timestamp) / (float)(timelineLength - 1)) - 1 + timeMarkerGap;
     if (timeMarkerAnimation.endTick != 0) {
@@ -763,7 +940,7 @@ void animateTimeMarkerToTimestamp(int timestamp) {
 }
 
 void updateTimeMarkerPosition(double posx) {
-    int timelineLength = utarray_len(rootTimeline->snapshots);
+    int timelineLength = rootTimeline->length;
     GLfloat timestampPercent = posx / WINDOW_WIDTH;
     int newCurrentTimestamp = round((timelineLength - 1) * timestampPercent);
     if (newCurrentTimestamp != currentTimestamp) {
@@ -784,6 +961,20 @@ void updateTimeMarkerState() {
         } else {
             timeMarkerAnimation.currentTick++;
         }
+        markDirty(DIRTY_TIME_MARKER);
+    }
+}
+
+// Uploads the textures whose images have finished decoding. Thumbnails
+// drawn with a placeholder are dropped from the atlas to be drawn again.
+void updateTextures() {
+    bool changed = updateTextureLoad(&glSettings.piecesTexture);
+    if (!glSettings.checkerBoard) {
+        changed = updateTextureLoad(&glSettings.boardTexture) || changed;
+    }
+    if (changed) {
+        clearThumbnailAtlas(&glSettings.atlas);
+        markDirty(DIRTY_ALL);
     }
 }
 
@@ -793,16 +984,14 @@ void initTimeline() {
 }
 
 void commitMove(int destPos, int srcPos) {
-    enum Piece piece = mainBoard.squares[srcPos];
-    if (destPos != srcPos) {
-        mainBoard.squares[destPos] = piece;
-        mainBoard.squares[srcPos] = Blank;
-    }
-    piece = mainBoard.squares[destPos];
-    updatePiecesBuffer(&glSettings, &mainBoard);
-    if (destPos != srcPos) {
-        addToTimeline(&mainBoard);
+    struct Move move;
+    // Illegal drops leave the board as it was, which snaps the piece back.
+    // Pawns reaching the last row always become queens.
+    if (findLegalMove(&mainBoard, srcPos, destPos, Queen, &move)) {
+        pushMove(&mainBoard, mainBoardHistory, move);
+        addToTimeline(&mainBoard, move);
     }
+    markDirty(DIRTY_MAIN_BOARD);
 }
 
 void updateDraggingPiecePosition(double posx, double posy) {
@@ -810,6 +999,7 @@ void updateDraggingPiecePosition(double posx, double posy) {
     // TODO
     draggingPieceX = posx - mainBoardView.x - (mainBoardView.size / 16.0);
     draggingPieceY = posy - mainBoardView.y - (mainBoardView.size / 16.0);
+    markDirty(DIRTY_MAIN_BOARD);
 }
 
 /*
@@ -840,7 +1030,7 @@ void handleMainBoardMouseClick(int button, int action, double posx, double posy)
         int row = (int)(8.0 * (posy - mainBoardView.y) / mainBoardView.size);
         int boardPos = row * 8 + column;
         if (action == GLFW_PRESS) {
-            printf("Start drag from row = %d, column = %d, boardPos = %d\n", row, column, boardPos);
+            LOG_DEBUG(LOG_INPUT, "Start drag from row = %d, column = %d, boardPos = %d", row, column, boardPos);
             draggingSquare = boardPos;
             updateDraggingPiecePosition(posx, posy);
         } else { // action == GLFW_RELEASE
@@ -876,6 +1066,11 @@ void mouseButtonCallback(GLFWwindow *window, int button, int action, int modifie
     }
 }
 
+// The window was uncovered or needs its contents again
+void windowRefreshCallback(GLFWwindow *window) {
+    markDirty(DIRTY_ALL);
+}
+
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     if (key == GLFW_KEY_LEFT && action == GLFW_PRESS) {
@@ -883,56 +1078,57 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         if (targetTimestamp < 0) {
             if (currTimeline->parent != NULL) {
                 currTimeline = currTimeline->parent;
-                targetTimestamp = utarray_len(currTimeline->snapshots) - 1;
-                layoutTimeline(rootTimeline);
+                targetTimestamp = currTimeline->length - 1;
             } else {
                 return;
             }
         }
         // animateTimeMarkerToTimestamp(targetTimestamp);
         currentTimestamp = targetTimestamp;
-        updateMainBoard();
-        printf("Set currentTimestamp to %d\n", currentTimestamp);
+        markDirty(DIRTY_MAIN_BOARD | DIRTY_TIME_MARKER);
+        if (!popMove(&mainBoard, mainBoardHistory)) {
+            // Stepped back past where mainBoard was last set from
+            updateMainBoard();
+        }
+        LOG_DEBUG(LOG_INPUT, "Set currentTimestamp to %d", currentTimestamp);
     } else if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS) {
-        printf("Right arrow\n");
+        LOG_DEBUG(LOG_INPUT, "Right arrow");
         int targetTimestamp = currentTimestamp + 1;
-        if (targetTimestamp >= utarray_len(currTimeline->snapshots)) {
+        if (targetTimestamp >= currTimeline->length) {
             if (utarray_len(currTimeline->children) > 0) {
-                printf("move to child timeline\n");
-                currTimeline = utarray_eltptr(currTimeline->children, 0);
+                LOG_DEBUG(LOG_INPUT, "move to child timeline");
+                currTimeline = timelineChild(currTimeline, 0);
                 targetTimestamp = 0;
-                layoutTimeline(rootTimeline);
             } else {
-                printf("cancel\n");
+                LOG_DEBUG(LOG_INPUT, "cancel");
                 return;
             }
         }
         // animateTimeMarkerToTimestamp(targetTimestamp);
         currentTimestamp = targetTimestamp;
-        updateMainBoard();
-        printf("Set currentTimestamp to %d\n", currentTimestamp);
+        markDirty(DIRTY_MAIN_BOARD | DIRTY_TIME_MARKER);
+        pushMove(&mainBoard, mainBoardHistory, timelineMove(currTimeline, currentTimestamp));
+        LOG_DEBUG(LOG_INPUT, "Set currentTimestamp to %d", currentTimestamp);
     } else if (key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
         if (currTimeline->parent != NULL) {
-            int childIdx = utarray_eltidx(currTimeline->parent->children, currTimeline);
+            int childIdx = timelineChildIndex(currTimeline->parent, currTimeline);
             int nextChildIdx = childIdx + 1;
             if (nextChildIdx >= utarray_len(currTimeline->parent->children)) {
                 nextChildIdx = 0;
             }
-            currTimeline = utarray_eltptr(currTimeline->parent->children, nextChildIdx);
+            currTimeline = timelineChild(currTimeline->parent, nextChildIdx);
             currentTimestamp = 0;
-            layoutTimeline(rootTimeline);
             updateMainBoard();
         }
     } else if (key == GLFW_KEY_UP && action == GLFW_PRESS) {
         if (currTimeline->parent != NULL) {
-            int childIdx = utarray_eltidx(currTimeline->parent->children, currTimeline);
+            int childIdx = timelineChildIndex(currTimeline->parent, currTimeline);
             int nextChildIdx = childIdx - 1;
             if (nextChildIdx < 0) {
                 nextChildIdx = utarray_len(currTimeline->parent->children) - 1;
             }
-            currTimeline = utarray_eltptr(currTimeline->parent->children, nextChildIdx);
+            currTimeline = timelineChild(currTimeline->parent, nextChildIdx);
             currentTimestamp = 0;
-            layoutTimeline(rootTimeline);
             updateMainBoard();
         }
     }
@@ -944,7 +1140,124 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 
 */
 
-int appMainLoop() {
+// Draws a window full of boards for a while with geometry shader quads
+// and then with vertex shader quads, and prints how long a frame took
+// with each. Each path gets programs and buffers of its own, which are
+// left for exit to clean up.
+int benchmarkQuadPaths(GLFWwindow *window) {
+    int numBoards = BENCHMARK_BOARDS_ACROSS * BENCHMARK_BOARDS_ACROSS;
+    struct BoardInstance instances[BENCHMARK_BOARDS_ACROSS * BENCHMARK_BOARDS_ACROSS];
+    struct Board board;
+    initBoard(&board);
+    struct BoardView view;
+    view.size = (GLfloat)WINDOW_WIDTH / BENCHMARK_BOARDS_ACROSS;
+    for (int i = 0; i < numBoards; i++) {
+        view.x = (i % BENCHMARK_BOARDS_ACROSS) * view.size;
+        view.y = (i / BENCHMARK_BOARDS_ACROSS) * view.size;
+        setBoardInstance(&instances[i], &view, &board);
+    }
+    
+    // Time the GPU, not the display
+    glfwSwapInterval(0);
+    for (int vertexQuads = 0; vertexQuads <= 1; vertexQuads++) {
+        struct GLSettings settings = { 0 };
+        settings.vertexQuads = vertexQuads;
+        settings.checkerBoard = glSettings.checkerBoard;
+        settings.checkerBoardStyle = glSettings.checkerBoardStyle;
+        CALL(initGLSettings(&settings));
+        CALL(initBuffers(&settings));
+        if (!settings.checkerBoard) {
+            finishTextureLoad(&settings.boardTexture);
+        }
+        finishTextureLoad(&settings.piecesTexture);
+        double start = 0;
+        for (int frame = -BENCHMARK_WARMUP_FRAMES; frame < BENCHMARK_FRAMES; frame++) {
+            if (frame == 0) {
+                glFinish();
+                start = glfwGetTime();
+            }
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            updateBoardInstanceBuffer(&settings, instances, numBoards);
+            renderBoards(&settings, numBoards, perspectiveMatrix, -1, 0, 0);
+            endStreamFrame(&settings.streamBuffer);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        glFinish();
+        double seconds = glfwGetTime() - start;
+        printf(
+            "%-15s  %d boards  %8.3f ms/frame  %10.0f boards/s\n",
+            vertexQuads ? "vertex shader" : "geometry shader", numBoards,
+            1000 * seconds / BENCHMARK_FRAMES, numBoards * BENCHMARK_FRAMES / seconds
+        );
+    }
+    return 0;
+}
+
+// Frees the timeline and puts root in its place, looking at ply timestamp
+// of current.
+void replaceTimeline(struct TimelineNode *root, struct TimelineNode *current, int timestamp) {
+    freeTimeline(rootTimeline);
+    rootTimeline = root;
+    currTimeline = current;
+    currentTimestamp = timestamp;
+    // The new first ply may be a set up position
+    updateMainBoard();
+    layoutTimeline(rootTimeline);
+    markDirty(DIRTY_ALL);
+}
+
+// Opens game (counting from 1) of filename as the whole timeline, or with
+// a session open, adds it to the session's tree so nothing saved is lost.
+// The file is indexed rather than read, so the games before it are only
+// scanned for their tags and ends, and the index is saved so later
+// launches skip even that.
+int openIndexedGame(const char *filename, long game) {
+    double start = glfwGetTime();
+    CALL(openPgnIndex(filename, 0, &pgnIndex));
+    double indexSeconds = glfwGetTime() - start;
+    if (journal.fd >= 0) {
+        CALL(importPgnGame(&pgnIndex, game - 1, &rootTimeline));
+        // The import may have split the branch being looked at
+        currTimeline = rootTimeline;
+        currentTimestamp = 0;
+        updateMainBoard();
+        layoutTimeline(rootTimeline);
+        markDirty(DIRTY_ALL);
+    } else {
+        struct TimelineNode *timeline;
+        CALL(openPgnGame(&pgnIndex, game - 1, &timeline));
+        replaceTimeline(timeline, timeline, 0);
+    }
+    struct PgnToken white = pgnGameTag(&pgnIndex, game - 1, PGN_TAG_WHITE);
+    struct PgnToken black = pgnGameTag(&pgnIndex, game - 1, PGN_TAG_BLACK);
+    LOG_INFO(LOG_TIMELINE, "Got the index of %ld game(s) in %.3fs, opened %.*s - %.*s in %.3fs",
+        pgnIndex.numGames, indexSeconds, white.length, white.text, black.length, black.text,
+        glfwGetTime() - start - indexSeconds);
+    return 0;
+}
+
+// Opens the session in filename, if there is one, and its journal, which
+// every ply added from then on is appended to.
+int openSession(const char *filename) {
+    double start = glfwGetTime();
+    CALL(openJournal(&journal, filename, glfwPostEmptyEvent, &rootTimeline, &currTimeline, &currentTimestamp));
+    LOG_INFO(LOG_TIMELINE, "Opened session %s in %.3fs", filename, glfwGetTime() - start);
+    updateMainBoard();
+    layoutTimeline(rootTimeline);
+    markDirty(DIRTY_ALL);
+    return 0;
+}
+
+struct AppOptions {
+    bool benchmark;        // time the quad paths and exit
+    char *pgnFilename;     // games to load, or NULL
+    long pgnGame;          // the only game of pgnFilename to load, counting from 1, or 0 for all
+    char *sessionFilename; // opened at startup, journaled to and saved on exit, or NULL
+    char *fen;             // the position the timeline starts from, or NULL for the usual one
+};
+
+int appMainLoop(struct AppOptions *options) {
     GLFWwindow* window = NULL;
     
     if (!glfwInit()) {
@@ -954,7 +1267,7 @@ int appMainLoop() {
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
     
     window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "MyChess", NULL, NULL);
@@ -972,6 +1285,8 @@ int appMainLoop() {
     glfwSetCursorEnterCallback(window, cursorEnterCallback);
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
     glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+    glfwSwapInterval(1);
     
     if (glewInit() != GLEW_OK) {
         printf("glewInit failed.\n");
@@ -980,49 +1295,182 @@ int appMainLoop() {
     
     displayGLVersions();
     
-    initGLSettings(&glSettings);
     glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Alpha adds up rather than being multiplied in, so that thumbnails
+    // drawn into the atlas stay opaque
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     glClearColor(0.05, 0.15, 0.05, 1.0);
-    initBuffers(&glSettings);
+    if (options->benchmark) {
+        if (benchmarkQuadPaths(window) != 0) {
+            finalize_error();
+            return 1;
+        }
+        return 0;
+    }
+    
+    printf("Quads: %s shader\n", glSettings.vertexQuads ? "vertex" : "geometry");
+    if (initGLSettings(&glSettings) != 0) {
+        finalize_error();
+        return 1;
+    }
+    if (initBuffers(&glSettings) != 0) {
+        finalize_error();
+        return 1;
+    }
     timeMarkerAnimation.endTick = 0;
     
-    initBoard(&mainBoard);
+    setPextAttacks(true);
+    if (options->fen == NULL) {
+        initBoard(&mainBoard);
+    } else if (boardFromFen(&mainBoard, options->fen) != 0) {
+        finalize_error();
+        return 1;
+    }
+    utarray_new(mainBoardHistory, &undo_entry_icd);
+    utarray_new(thumbnailInstances, &thumbnail_instance_icd);
+    utarray_new(atlasMissInstances, &board_instance_icd);
+    utarray_new(uncachedInstances, &board_instance_icd);
+    utarray_new(transpositionMarkVertices, &vertex_icd);
     
     mainBoardView.x = (float)WINDOW_WIDTH / 4;
     mainBoardView.y = 0;
     mainBoardView.size = (float)WINDOW_WIDTH / 2;
     
     initTimeline();
-    timelineView.children = NULL;
     
-    addToTimeline(&mainBoard);
+    struct Move noMove = { 0 };
+    addToTimeline(&mainBoard, noMove);
+    if (options->sessionFilename != NULL && openSession(options->sessionFilename) != 0) {
+        finalize_error();
+        return 1;
+    }
+    if (options->pgnFilename != NULL && options->pgnGame > 0) {
+        if (openIndexedGame(options->pgnFilename, options->pgnGame) != 0) {
+            finalize_error();
+            return 1;
+        }
+    } else if (options->pgnFilename != NULL && importGames(options->pgnFilename) != 0) {
+        finalize_error();
+        return 1;
+    }
+    if (options->pgnFilename != NULL) {
+        // Too much to journal ply by ply
+        requestCompaction(&journal);
+    }
     
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        // glfwWaitEvents();
+        // Before any input, so a replaced tree is snapshotted before moves
+        // are journaled against it
+        updateJournal(&journal, rootTimeline, currTimeline, currentTimestamp);
+        if (dirtyRegions == 0 && timeMarkerAnimation.endTick == 0) {
+            // Idle: sleep until there is input or the window needs redrawing
+            glfwWaitEvents();
+        } else {
+            glfwPollEvents();
+        }
+        updateTimeMarkerState();
+        updateTextures();
+        if (dirtyRegions == 0) {
+            continue;
+        }
+        
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        updateBoardBuffer(&glSettings, &mainBoardView);
-        updatePiecesBuffer(&glSettings, &mainBoard);
+        struct BoardInstance mainBoardInstance;
+        setBoardInstance(&mainBoardInstance, &mainBoardView, &mainBoard);
+        updateBoardInstanceBuffer(&glSettings, &mainBoardInstance, 1);
         // printf("boardView.x = %f, boardView.y = %f\n", mainBoardView.x, mainBoardView.y);
         
-        renderBoard(&glSettings, &mainBoardView, draggingSquare, draggingPieceX, draggingPieceY);
-        renderTimeline();
-        updateTimeMarkerState();
+        renderBoards(&glSettings, 1, perspectiveMatrix, draggingSquare, draggingPieceX, draggingPieceY);
+        renderTimeline(dirtyRegions & DIRTY_TIMELINE);
         renderTimeMarker();
+        endStreamFrame(&glSettings.streamBuffer);
+        dirtyRegions = 0;
         glfwSwapBuffers(window);
     }
     
     glBindVertexArray(0);
     glUseProgram(0);
     
+    closeJournal(&journal, rootTimeline, currTimeline, currentTimestamp);
+    return 0;
+}
+
+// Reads an opaque color written as RRGGBB, like b5651d.
+int parseColor(char *hex, GLfloat color[4]) {
+    unsigned r, g, b;
+    int length;
+    if (sscanf(hex, "%2x%2x%2x%n", &r, &g, &b, &length) != 3 || length != 6 || hex[6] != '\0') {
+        return 1;
+    }
+    color[0] = r / 255.0;
+    color[1] = g / 255.0;
+    color[2] = b / 255.0;
+    color[3] = 1.0;
     return 0;
 }
 
-int main() {
-    if (appMainLoop() != 0) {
+/*
+
+    ./gl_chess.bin [options]
+
+    --vertex-quads                 expand quads in the vertex shader rather
+                                   than in geometry shaders, which are slow
+                                   on some drivers, llvmpipe among them
+    --benchmark-quads              time drawing boards both ways and exit
+    --checker-board                draw the board background in a shader
+                                   rather than from board.png
+    --board-colors <light> <dark>  checker board square colors, as RRGGBB
+    --no-coordinates               leave files and ranks off the checker board
+    --pgn <file>                   load the games in file into the timeline
+    --game <n>                     only load game n of the --pgn file, from
+                                   an index built across all cores; with
+                                   --session, it is added to the session
+    --session <file>               open the timeline saved in file, if there
+                                   is one, journal every move to
+                                   <file>.journal and save it on exit
+    --fen <fen>                    start the timeline from the position in
+                                   fen rather than the usual one
+
+*/
+int main(int argc, char **argv) {
+    struct AppOptions options = { false, NULL, 0, NULL, NULL };
+    glSettings.checkerBoardStyle = defaultCheckerBoardStyle;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vertex-quads") == 0) {
+            glSettings.vertexQuads = true;
+        } else if (strcmp(argv[i], "--benchmark-quads") == 0) {
+            options.benchmark = true;
+        } else if (strcmp(argv[i], "--checker-board") == 0) {
+            glSettings.checkerBoard = true;
+        } else if (strcmp(argv[i], "--board-colors") == 0 && i + 2 < argc &&
+            parseColor(argv[i + 1], glSettings.checkerBoardStyle.lightColor) == 0 &&
+            parseColor(argv[i + 2], glSettings.checkerBoardStyle.darkColor) == 0) {
+            glSettings.checkerBoard = true;
+            i += 2;
+        } else if (strcmp(argv[i], "--no-coordinates") == 0) {
+            glSettings.checkerBoardStyle.coordinates = false;
+        } else if (strcmp(argv[i], "--pgn") == 0 && i + 1 < argc) {
+            options.pgnFilename = argv[++i];
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0) {
+            options.pgnGame = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+            options.sessionFilename = argv[++i];
+        } else if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            options.fen = argv[++i];
+        } else {
+            fprintf(stderr,
+                "usage: %s [--vertex-quads] [--benchmark-quads] [--checker-board]\n"
+                "    [--board-colors <light> <dark>] [--no-coordinates]\n"
+                "    [--pgn <file> [--game <n>]] [--session <file>] [--fen <fen>]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    init_log();
+    if (appMainLoop(&options) != 0) {
         printf("initApp failed.\n");
     }
+    stop_async_log();
     
     printf("Done.\n");
     return 0;
@@ -0,0 +1,447 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "errors.h"
+#include "log.h"
+#include "mapped_file.h"
+#include "movegen.h"
+#include "journal.h"
+
+#define JOURNAL_VERSION 1
+#define JOURNAL_PATH_MAX_SIZE 1024
+// Plies this many branches deep are left to the next compaction
+#define JOURNAL_MAX_CHOICES 1024
+
+#define JOURNAL_ADD_PLY 1
+
+static const char journalMagic[4] = { 'G', 'C', 'J', 'N' };
+
+struct JournalHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+// Followed by numChoices uint16_t's: the child taken at each branch on
+// the way from the root to the ply the move follows.
+struct JournalRecord {
+    uint32_t checksum; // FNV-1a of the rest of the record
+    uint32_t sequence;
+    uint32_t ply;      // plies from the root to the one the move follows
+    struct Move move;
+    uint16_t numChoices;
+    uint8_t type;      // JOURNAL_* record type
+    uint8_t unused;
+};
+
+static uint32_t recordChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool writeJournalHeader(int fd) {
+    struct JournalHeader header;
+    memcpy(header.magic, journalMagic, sizeof(journalMagic));
+    header.version = JOURNAL_VERSION;
+    return write(fd, &header, sizeof(header)) == sizeof(header);
+}
+
+// Finds the ply record was played after.
+static bool findRecordPly(
+    struct TimelineNode *root, const struct JournalRecord *record, const char *choices,
+    struct TimelineNode **timeline, int *index
+) {
+    struct TimelineNode *node = root;
+    int startPly = 0;
+    int numTaken = 0;
+    while (record->ply >= (uint32_t)(startPly + node->length)) {
+        uint16_t child;
+        if (numTaken == record->numChoices) {
+            return false;
+        }
+        memcpy(&child, choices + 2 * numTaken++, sizeof(child));
+        if (child >= utarray_len(node->children)) {
+            return false;
+        }
+        startPly += node->length;
+        node = timelineChild(node, child);
+    }
+    *timeline = node;
+    *index = record->ply - startPly;
+    return numTaken == record->numChoices;
+}
+
+static bool replayRecord(
+    const struct JournalRecord *record, const char *choices,
+    struct TimelineNode **root, struct TimelineNode **current, int *currentTimestamp
+) {
+    struct TimelineNode *timeline;
+    int index;
+    if (record->type != JOURNAL_ADD_PLY || !findRecordPly(*root, record, choices, &timeline, &index)) {
+        return false;
+    }
+    struct Board board;
+    struct Move move;
+    getTimelineBoard(timeline, index, &board);
+    if (!findLegalMove(&board, record->move.from, record->move.to, record->move.promotion, &move) ||
+        memcmp(&move, &record->move, sizeof(move)) != 0) {
+        return false;
+    }
+    applyMove(&board, move);
+    *current = addPly(root, timeline, index, &board, move, NULL);
+    *currentTimestamp = (*current)->length - 1;
+    return true;
+}
+
+// Plays the records after the session's onto the tree, and sets
+// *validSize to where the last whole one ends.
+static int replayJournal(
+    struct Journal *journal, struct TimelineNode **root,
+    struct TimelineNode **current, int *currentTimestamp, size_t *validSize
+) {
+    struct MappedFile file;
+    CALL(mapFile(journal->path, &file));
+    *validSize = 0;
+    if (file.size == 0) {
+        return 0;
+    }
+    const struct JournalHeader *header = (const struct JournalHeader *)file.data;
+    if (file.size < sizeof(struct JournalHeader) ||
+        memcmp(header->magic, journalMagic, sizeof(journalMagic)) != 0 ||
+        header->version != JOURNAL_VERSION) {
+        unmapFile(&file);
+        set_error(1, "%s is not a journal this build can read", journal->path);
+        return 1;
+    }
+
+    size_t offset = sizeof(struct JournalHeader);
+    long numReplayed = 0;
+    while (file.size - offset >= sizeof(struct JournalRecord)) {
+        struct JournalRecord record;
+        memcpy(&record, file.data + offset, sizeof(record));
+        size_t length = sizeof(record) + 2 * record.numChoices;
+        if (length > file.size - offset ||
+            recordChecksum((const uint8_t *)file.data + offset + 4, length - 4) != record.checksum) {
+            break;
+        }
+        if (record.sequence > journal->sequence) {
+            const char *choices = file.data + offset + sizeof(record);
+            if (!replayRecord(&record, choices, root, current, currentTimestamp)) {
+                LOG_WARN(LOG_TIMELINE, "Journal record %u does not fit the tree", record.sequence);
+                break;
+            }
+            journal->sequence = record.sequence;
+            numReplayed++;
+        }
+        offset += length;
+    }
+    if (offset < file.size) {
+        LOG_WARN(LOG_TIMELINE, "Dropping the last %zu bytes of %s", file.size - offset, journal->path);
+    }
+    *validSize = offset;
+    LOG_INFO(LOG_TIMELINE, "Replayed %ld journal record(s) from %s", numReplayed, journal->path);
+    unmapFile(&file);
+    return 0;
+}
+
+// Syncs what was appended, a while after it was, so that a burst of moves
+// costs one sync.
+static void *syncJournal(void *arg) {
+    struct Journal *journal = arg;
+    pthread_mutex_lock(&journal->lock);
+    for (;;) {
+        while (!journal->dirty && !journal->stopping) {
+            pthread_cond_wait(&journal->changed, &journal->lock);
+        }
+        if (journal->stopping) {
+            // closeJournal syncs the rest
+            break;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += JOURNAL_SYNC_INTERVAL_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (!journal->stopping &&
+            pthread_cond_timedwait(&journal->changed, &journal->lock, &deadline) != ETIMEDOUT) {
+        }
+        journal->dirty = false;
+        // Compaction may swap the file while this one is being synced
+        int fd = dup(journal->fd);
+        pthread_mutex_unlock(&journal->lock);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+        pthread_mutex_lock(&journal->lock);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+static void freeJournalPaths(struct Journal *journal) {
+    free(journal->sessionPath);
+    free(journal->path);
+    journal->sessionPath = NULL;
+    journal->path = NULL;
+}
+
+// Opens the session in sessionFilename and its journal, replacing *root
+// with the saved tree if there is one and replaying the journal onto it.
+// *current and *currentTimestamp are set to the ply last added, or the one
+// being looked at when the session was saved.
+int openJournal(
+    struct Journal *journal, const char *sessionFilename, void (*wake)(void),
+    struct TimelineNode **root, struct TimelineNode **current, int *currentTimestamp
+) {
+    memset(journal, 0, sizeof(*journal));
+    journal->fd = -1;
+    journal->wake = wake;
+    if (strlen(sessionFilename) + sizeof(".journal.tmp") > JOURNAL_PATH_MAX_SIZE) {
+        set_error(1, "Session path too long: %s", sessionFilename);
+        return 1;
+    }
+    if (access(sessionFilename, F_OK) == 0) {
+        struct TimelineNode *savedRoot;
+        CALL(loadSession(sessionFilename, &savedRoot, current, currentTimestamp, &journal->sequence));
+        freeTimeline(*root);
+        *root = savedRoot;
+    }
+    journal->sessionPath = strdup(sessionFilename);
+    journal->path = malloc(JOURNAL_PATH_MAX_SIZE);
+    snprintf(journal->path, JOURNAL_PATH_MAX_SIZE, "%s.journal", sessionFilename);
+
+    size_t validSize = 0;
+    if (access(journal->path, F_OK) == 0 &&
+        replayJournal(journal, root, current, currentTimestamp, &validSize) != 0) {
+        freeJournalPaths(journal);
+        return 1;
+    }
+    int fd = open(journal->path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    bool opened = fd >= 0;
+    if (opened && validSize == 0) {
+        opened = ftruncate(fd, 0) == 0 && writeJournalHeader(fd);
+        validSize = sizeof(struct JournalHeader);
+    } else if (opened) {
+        // Drop a record torn by a crash, so new ones follow whole ones
+        opened = ftruncate(fd, validSize) == 0;
+    }
+    if (!opened) {
+        set_error(1, "%s: %s", journal->path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        freeJournalPaths(journal);
+        return 1;
+    }
+    journal->size = validSize;
+    journal->compactAt = validSize + JOURNAL_COMPACT_SIZE;
+
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->changed, NULL);
+    if (pthread_create(&journal->syncThread, NULL, syncJournal, journal) != 0) {
+        set_error(1, "Could not start syncing %s", journal->path);
+        close(fd);
+        freeJournalPaths(journal);
+        return 1;
+    }
+    journal->fd = fd;
+    return 0;
+}
+
+// Journals move, played after ply index of timeline. Call it before the
+// ply is added, while the path to index is still the one it is replayed
+// from.
+void journalAddPly(struct Journal *journal, struct TimelineNode *timeline, int index, struct Move move) {
+    if (journal->fd < 0) {
+        return;
+    }
+    int depth = 0;
+    for (struct TimelineNode *node = timeline; node->parent != NULL; node = node->parent) {
+        depth++;
+    }
+    if (depth > JOURNAL_MAX_CHOICES) {
+        journal->compactAt = 0;
+        return;
+    }
+
+    char buffer[sizeof(struct JournalRecord) + 2 * JOURNAL_MAX_CHOICES];
+    struct JournalRecord record;
+    size_t length = sizeof(record) + 2 * depth;
+    memset(&record, 0, sizeof(record));
+    record.sequence = journal->sequence + 1;
+    record.ply = timelineStartPly(timeline) + index;
+    record.move = move;
+    record.numChoices = depth;
+    record.type = JOURNAL_ADD_PLY;
+    int choice = depth;
+    for (struct TimelineNode *node = timeline; node->parent != NULL; node = node->parent) {
+        uint16_t child = timelineChildIndex(node->parent, node);
+        memcpy(buffer + sizeof(record) + 2 * --choice, &child, sizeof(child));
+    }
+    memcpy(buffer, &record, sizeof(record));
+    record.checksum = recordChecksum((const uint8_t *)buffer + 4, length - 4);
+    memcpy(buffer, &record.checksum, sizeof(record.checksum));
+
+    if (write(journal->fd, buffer, length) != (ssize_t)length) {
+        LOG_ERROR(LOG_TIMELINE, "Could not append to %s: %s", journal->path, strerror(errno));
+        // Cut off any part of the record, and get the ply saved by a
+        // compaction instead
+        if (ftruncate(journal->fd, journal->size) != 0) {
+            LOG_ERROR(LOG_TIMELINE, "Could not truncate %s: %s", journal->path, strerror(errno));
+        }
+        journal->compactAt = 0;
+        return;
+    }
+    journal->sequence++;
+    journal->size += length;
+    pthread_mutex_lock(&journal->lock);
+    if (!journal->dirty) {
+        journal->dirty = true;
+        pthread_cond_signal(&journal->changed);
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+static void *compactSession(void *arg) {
+    struct Journal *journal = arg;
+    int status = writeSession(journal->sessionPath, &journal->snapshot);
+    pthread_mutex_lock(&journal->lock);
+    journal->compactStatus = status;
+    journal->compactDone = true;
+    pthread_mutex_unlock(&journal->lock);
+    if (journal->wake != NULL) {
+        journal->wake();
+    }
+    return NULL;
+}
+
+// Copies the tree and writes it out as the session, on another thread if
+// background is set.
+static void startCompaction(
+    struct Journal *journal, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp, bool background
+) {
+    collectSession(&journal->snapshot, root, current, currentTimestamp, journal->sequence);
+    journal->compactedSize = journal->size;
+    journal->compacting = true;
+    journal->compactDone = false;
+    if (background && pthread_create(&journal->compactThread, NULL, compactSession, journal) == 0) {
+        return;
+    }
+    compactSession(journal);
+    // Nothing to join
+    journal->compactThread = pthread_self();
+}
+
+// Replaces the journal with the records appended since the snapshot was
+// taken.
+static void cutJournal(struct Journal *journal) {
+    size_t tailSize = journal->size - journal->compactedSize;
+    char *tail = malloc(tailSize > 0 ? tailSize : 1);
+    char tempPath[JOURNAL_PATH_MAX_SIZE];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", journal->path);
+    int fd = open(tempPath, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    bool cut = fd >= 0 &&
+        pread(journal->fd, tail, tailSize, journal->compactedSize) == (ssize_t)tailSize &&
+        writeJournalHeader(fd) &&
+        (tailSize == 0 || write(fd, tail, tailSize) == (ssize_t)tailSize) &&
+        fsync(fd) == 0 &&
+        rename(tempPath, journal->path) == 0;
+    free(tail);
+    if (!cut) {
+        // The session skips the records it has, so the journal can grow on
+        LOG_WARN(LOG_TIMELINE, "Could not cut %s: %s", journal->path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            remove(tempPath);
+        }
+        return;
+    }
+    pthread_mutex_lock(&journal->lock);
+    int oldFd = journal->fd;
+    journal->fd = fd;
+    pthread_mutex_unlock(&journal->lock);
+    close(oldFd);
+    journal->size = sizeof(struct JournalHeader) + tailSize;
+}
+
+static void finishCompaction(struct Journal *journal) {
+    if (!pthread_equal(journal->compactThread, pthread_self())) {
+        pthread_join(journal->compactThread, NULL);
+    }
+    freeSessionSnapshot(&journal->snapshot);
+    journal->compacting = false;
+    if (journal->compactStatus == 0) {
+        cutJournal(journal);
+    } else {
+        finalize_error();
+        LOG_WARN(LOG_TIMELINE, "Keeping everything in %s until the session can be saved", journal->path);
+    }
+    journal->compactAt = journal->size + JOURNAL_COMPACT_SIZE;
+}
+
+// Compacts the journal at the next updateJournal, after a change too big
+// to journal, like loading games.
+void requestCompaction(struct Journal *journal) {
+    journal->compactAt = 0;
+}
+
+// Starts a compaction if the journal has grown enough, or finishes one
+// that is done. Call it from the main loop: it reads the tree.
+void updateJournal(
+    struct Journal *journal, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp
+) {
+    if (journal->fd < 0) {
+        return;
+    }
+    if (journal->compacting) {
+        pthread_mutex_lock(&journal->lock);
+        bool done = journal->compactDone;
+        pthread_mutex_unlock(&journal->lock);
+        if (done) {
+            finishCompaction(journal);
+        }
+        return;
+    }
+    if (journal->size >= journal->compactAt) {
+        startCompaction(journal, root, current, currentTimestamp, true);
+    }
+}
+
+// Saves the session, leaving the journal empty, and closes it.
+void closeJournal(
+    struct Journal *journal, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp
+) {
+    if (journal->fd < 0) {
+        return;
+    }
+    if (journal->compacting) {
+        finishCompaction(journal);
+    }
+    startCompaction(journal, root, current, currentTimestamp, false);
+    finishCompaction(journal);
+
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = true;
+    pthread_cond_signal(&journal->changed);
+    pthread_mutex_unlock(&journal->lock);
+    pthread_join(journal->syncThread, NULL);
+    fsync(journal->fd);
+    close(journal->fd);
+    journal->fd = -1;
+    pthread_cond_destroy(&journal->changed);
+    pthread_mutex_destroy(&journal->lock);
+    freeJournalPaths(journal);
+}
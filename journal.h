@@ -0,0 +1,72 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "session.h"
+#include "timeline.h"
+
+/*
+
+Keeps a session file (see session.h) up to date without rewriting it for
+every move. Each ply added to the timeline appends a small record to
+<session>.journal: the move, and where in the tree it was played, as the
+ply it follows and the child taken at each branch on the way there. A
+fork is the same record, played after a ply that already has a next one.
+Appending is one write(), and a thread calls fsync() on whatever
+piled up every JOURNAL_SYNC_INTERVAL_MS, so adding a ply never waits for
+the disk.
+
+Once the journal grows past JOURNAL_COMPACT_SIZE, the tree is copied and
+written as a new session file on another thread, and the journal is cut
+back to the records that came after the copy. Records are numbered and
+the session file holds the number of the last one it includes, so a
+crash at any point of that leaves the session and journal replaying to
+the same tree.
+
+Opening replays the journal onto the session file. A record torn by a
+crash fails its checksum and it, and anything after it, is dropped.
+
+*/
+
+#define JOURNAL_SYNC_INTERVAL_MS 200
+#define JOURNAL_COMPACT_SIZE (256 * 1024)
+
+struct Journal {
+    int fd;                      // -1 when no journal is open
+    char *sessionPath;
+    char *path;
+    uint32_t sequence;           // of the last record appended
+    size_t size;                 // of the journal file
+    size_t compactAt;            // size to start the next compaction at
+    void (*wake)(void);          // called when a compaction finishes, may be NULL
+
+    pthread_mutex_t lock;        // guards fd swaps, dirty, stopping and compactDone
+    pthread_cond_t changed;
+    pthread_t syncThread;
+    bool dirty;                  // appended to since the last sync
+    bool stopping;
+
+    bool compacting;
+    pthread_t compactThread;
+    struct SessionSnapshot snapshot;
+    size_t compactedSize;        // journal size when the snapshot was taken
+    bool compactDone;
+    int compactStatus;
+};
+
+int openJournal(
+    struct Journal *journal, const char *sessionFilename, void (*wake)(void),
+    struct TimelineNode **root, struct TimelineNode **current, int *currentTimestamp);
+void journalAddPly(struct Journal *journal, struct TimelineNode *timeline, int index, struct Move move);
+void requestCompaction(struct Journal *journal);
+void updateJournal(
+    struct Journal *journal, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp);
+void closeJournal(
+    struct Journal *journal, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp);
+
+#endif
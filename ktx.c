@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "errors.h"
+#include "ktx.h"
+
+#define KTX_ENDIANNESS 0x04030201
+
+static const unsigned char ktxIdentifier[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+struct KtxHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+bool isKtxFile(const char *filename) {
+    size_t length = strlen(filename);
+    return length >= 4 && strcmp(filename + length - 4, ".ktx") == 0;
+}
+
+// Reads the whole file into image->data; the levels point into it. On
+// failure, why goes into error rather than the error state, since textures
+// are read on threads of their own.
+int readKtx(const char *filename, struct KtxImage *image, char error[KTX_ERROR_MAX_SIZE]) {
+    image->data = NULL;
+    error[0] = '\0';
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+        snprintf(error, KTX_ERROR_MAX_SIZE, "%s: %s", filename, strerror(errno));
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long fileSize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *data = malloc(fileSize);
+    size_t read = fread(data, 1, fileSize, f);
+    fclose(f);
+
+    struct KtxHeader header;
+    if (read != (size_t)fileSize || fileSize < (long)sizeof(header)) {
+        snprintf(error, KTX_ERROR_MAX_SIZE, "%s: too short for a KTX file", filename);
+        free(data);
+        return 1;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.identifier, ktxIdentifier, sizeof(ktxIdentifier)) != 0 ||
+        header.endianness != KTX_ENDIANNESS) {
+        snprintf(error, KTX_ERROR_MAX_SIZE, "%s: not a KTX file in this machine's byte order", filename);
+        free(data);
+        return 1;
+    }
+    if (header.glType != 0 || header.pixelDepth > 1 || header.numberOfArrayElements > 0 ||
+        header.numberOfFaces != 1 || header.numberOfMipmapLevels < 1 ||
+        header.numberOfMipmapLevels > KTX_MAX_LEVELS) {
+        snprintf(error, KTX_ERROR_MAX_SIZE, "%s: only compressed 2D textures with mip levels are supported", filename);
+        free(data);
+        return 1;
+    }
+
+    image->internalFormat = header.glInternalFormat;
+    image->baseInternalFormat = header.glBaseInternalFormat;
+    image->width = header.pixelWidth;
+    image->height = header.pixelHeight;
+    image->numLevels = header.numberOfMipmapLevels;
+    long offset = sizeof(header) + header.bytesOfKeyValueData;
+    for (int level = 0; level < image->numLevels; level++) {
+        uint32_t size;
+        if (offset + (long)sizeof(size) > fileSize) {
+            break;
+        }
+        memcpy(&size, data + offset, sizeof(size));
+        offset += sizeof(size);
+        if (offset + (long)size > fileSize) {
+            break;
+        }
+        image->levelSizes[level] = size;
+        image->levels[level] = data + offset;
+        offset += (size + 3) & ~3u;
+        if (level == image->numLevels - 1) {
+            image->data = data;
+            return 0;
+        }
+    }
+    snprintf(error, KTX_ERROR_MAX_SIZE, "%s: truncated", filename);
+    free(data);
+    return 1;
+}
+
+int writeKtx(const char *filename, const struct KtxImage *image) {
+    struct KtxHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.identifier, ktxIdentifier, sizeof(ktxIdentifier));
+    header.endianness = KTX_ENDIANNESS;
+    header.glTypeSize = 1;
+    header.glInternalFormat = image->internalFormat;
+    header.glBaseInternalFormat = image->baseInternalFormat;
+    header.pixelWidth = image->width;
+    header.pixelHeight = image->height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = image->numLevels;
+
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) {
+        set_error(1, "%s: %s", filename, strerror(errno));
+        return 1;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (int level = 0; written && level < image->numLevels; level++) {
+        uint32_t size = image->levelSizes[level];
+        uint32_t zero = 0;
+        written = fwrite(&size, sizeof(size), 1, f) == 1 &&
+            fwrite(image->levels[level], 1, size, f) == size &&
+            fwrite(&zero, 1, (4 - size % 4) % 4, f) == (4 - size % 4) % 4;
+    }
+    if (fclose(f) != 0 || !written) {
+        set_error(1, "Could not write %s", filename);
+        return 1;
+    }
+    return 0;
+}
+
+void freeKtx(struct KtxImage *image) {
+    free(image->data);
+    image->data = NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+
+Reads and writes the subset of KTX 1.1 that baked textures use: one 2D
+image, one face, not an array, with its mip levels.
+https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html
+
+Files are written in the byte order of the machine that bakes them and
+read back on machines of the same order, which is every one this runs on.
+
+*/
+
+#define KTX_MAX_LEVELS 16
+// GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, also known as BC3
+#define KTX_COMPRESSED_RGBA_DXT5 0x83F3
+#define KTX_RGBA 0x1908
+#define KTX_ERROR_MAX_SIZE 256
+
+struct KtxImage {
+    uint32_t internalFormat; // a compressed GL internal format
+    uint32_t baseInternalFormat;
+    int width;               // of level 0
+    int height;
+    int numLevels;
+    uint32_t levelSizes[KTX_MAX_LEVELS];
+    unsigned char *levels[KTX_MAX_LEVELS]; // into data
+    unsigned char *data;
+};
+
+bool isKtxFile(const char *filename);
+int readKtx(const char *filename, struct KtxImage *image, char error[KTX_ERROR_MAX_SIZE]);
+int writeKtx(const char *filename, const struct KtxImage *image);
+void freeKtx(struct KtxImage *image);
+
+#endif
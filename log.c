@@ -0,0 +1,191 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "errors.h"
+#include "log.h"
+
+static char *levelNames[] = { "none", "error", "warn", "info", "debug" };
+static char *categoryNames[NUM_LOG_CATEGORIES] = {
+    "general", "timeline", "layout", "input", "render"
+};
+
+int log_levels[NUM_LOG_CATEGORIES] = {
+    LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO
+};
+
+// The async sink. Slots between head and tail hold formatted lines
+// waiting for the writer thread.
+struct LogRing {
+    char (*slots)[LOG_MESSAGE_MAX_SIZE];
+    int capacity;
+    int head; // next slot to write out
+    int tail; // next slot to fill
+    int count;
+    int dropped;
+    bool running;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+};
+
+struct LogRing log_ring = {
+    .slots = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER
+};
+
+int parse_level(char *name, int length) {
+    for (int level = LOG_LEVEL_NONE; level <= LOG_LEVEL_DEBUG; level++) {
+        if (strlen(levelNames[level]) == length && strncmp(name, levelNames[level], length) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+void set_log_level(enum LogCategory category, int level) {
+    log_levels[category] = level;
+}
+
+int start_async_log(int capacity);
+
+// Applies GL_CHESS_LOG. Unknown entries are reported and skipped.
+void init_log() {
+    char *spec = getenv("GL_CHESS_LOG");
+    while (spec != NULL && *spec != '\0') {
+        int length = strcspn(spec, ",");
+        char *equals = memchr(spec, '=', length);
+        if (length == 5 && strncmp(spec, "async", 5) == 0) {
+            if (start_async_log(LOG_RING_CAPACITY) != 0) {
+                finalize_error();
+            }
+        } else if (equals == NULL) {
+            int level = parse_level(spec, length);
+            for (int category = 0; category < NUM_LOG_CATEGORIES && level >= 0; category++) {
+                log_levels[category] = level;
+            }
+            if (level < 0) {
+                fprintf(stderr, "GL_CHESS_LOG: unknown level %.*s\n", length, spec);
+            }
+        } else {
+            int nameLength = equals - spec;
+            int level = parse_level(equals + 1, length - nameLength - 1);
+            int category = 0;
+            while (category < NUM_LOG_CATEGORIES &&
+                !(strlen(categoryNames[category]) == nameLength &&
+                    strncmp(spec, categoryNames[category], nameLength) == 0)) {
+                category++;
+            }
+            if (category == NUM_LOG_CATEGORIES || level < 0) {
+                fprintf(stderr, "GL_CHESS_LOG: bad entry %.*s\n", length, spec);
+            } else {
+                log_levels[category] = level;
+            }
+        }
+        spec += length;
+        if (*spec == ',') {
+            spec++;
+        }
+    }
+}
+
+bool log_enabled(enum LogCategory category, int level) {
+    return level <= log_levels[category];
+}
+
+void log_message(int level, enum LogCategory category, char *format, ...) {
+    char line[LOG_MESSAGE_MAX_SIZE];
+    int prefixLength = snprintf(
+        line, sizeof(line), "[%s %s] ", levelNames[level], categoryNames[category]
+    );
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + prefixLength, sizeof(line) - prefixLength, format, args);
+    va_end(args);
+
+    pthread_mutex_lock(&log_ring.lock);
+    if (!log_ring.running) {
+        pthread_mutex_unlock(&log_ring.lock);
+        puts(line);
+        return;
+    }
+    if (log_ring.count == log_ring.capacity) {
+        log_ring.dropped++;
+    } else {
+        memcpy(log_ring.slots[log_ring.tail], line, sizeof(line));
+        log_ring.tail = (log_ring.tail + 1) % log_ring.capacity;
+        log_ring.count++;
+        pthread_cond_signal(&log_ring.ready);
+    }
+    pthread_mutex_unlock(&log_ring.lock);
+}
+
+void *log_writer(void *unused) {
+    char line[LOG_MESSAGE_MAX_SIZE];
+    pthread_mutex_lock(&log_ring.lock);
+    for (;;) {
+        while (log_ring.count == 0 && log_ring.running) {
+            pthread_cond_wait(&log_ring.ready, &log_ring.lock);
+        }
+        if (log_ring.count == 0) {
+            break;
+        }
+        memcpy(line, log_ring.slots[log_ring.head], sizeof(line));
+        log_ring.head = (log_ring.head + 1) % log_ring.capacity;
+        log_ring.count--;
+        int dropped = log_ring.dropped;
+        log_ring.dropped = 0;
+
+        // Write without holding the lock so loggers never wait on stdout
+        pthread_mutex_unlock(&log_ring.lock);
+        if (dropped > 0) {
+            printf("[warn general] log ring full, dropped %d message(s)\n", dropped);
+        }
+        puts(line);
+        pthread_mutex_lock(&log_ring.lock);
+    }
+    pthread_mutex_unlock(&log_ring.lock);
+    fflush(stdout);
+    return NULL;
+}
+
+// Sends messages through a ring of capacity lines written out by a
+// background thread, until stop_async_log.
+int start_async_log(int capacity) {
+    if (log_ring.running) {
+        return 0;
+    }
+    log_ring.slots = malloc(capacity * sizeof(*log_ring.slots));
+    log_ring.capacity = capacity;
+    log_ring.head = 0;
+    log_ring.tail = 0;
+    log_ring.count = 0;
+    log_ring.dropped = 0;
+    log_ring.running = true;
+    if (pthread_create(&log_ring.writer, NULL, log_writer, NULL) != 0) {
+        log_ring.running = false;
+        free(log_ring.slots);
+        log_ring.slots = NULL;
+        set_error(1, "Could not start the log writer thread");
+        return 1;
+    }
+    return 0;
+}
+
+// Writes out whatever is still queued and goes back to logging directly.
+void stop_async_log() {
+    pthread_mutex_lock(&log_ring.lock);
+    if (!log_ring.running) {
+        pthread_mutex_unlock(&log_ring.lock);
+        return;
+    }
+    log_ring.running = false;
+    pthread_cond_signal(&log_ring.ready);
+    pthread_mutex_unlock(&log_ring.lock);
+    pthread_join(log_ring.writer, NULL);
+    free(log_ring.slots);
+    log_ring.slots = NULL;
+}
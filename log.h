@@ -0,0 +1,79 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+
+/*
+
+Leveled, per category logging. LOG_LEVEL picks the most verbose level
+compiled in; anything above it compiles to nothing, arguments included.
+It defaults to LOG_LEVEL_DEBUG, or to LOG_LEVEL_NONE when NDEBUG is
+defined, and can be set with -DLOG_LEVEL=<n>.
+
+    LOG_DEBUG(LOG_TIMELINE, "pushed ply %d", ply);
+
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_TIMELINE)) {
+        // build something expensive to log
+    }
+
+Which of the compiled in messages are written is decided at runtime by
+GL_CHESS_LOG, a comma separated list of "<level>" or "<category>=<level>",
+e.g. GL_CHESS_LOG=info,timeline=debug. The default is info.
+
+Messages go to stdout as they are logged. start_async_log, or "async" in
+GL_CHESS_LOG, switches to a ring buffer drained by a writer thread, so
+logging never waits on the terminal; when the ring is full, messages are
+dropped and counted.
+
+*/
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_NONE
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_MESSAGE_MAX_SIZE 256
+#define LOG_RING_CAPACITY 4096 // lines
+
+enum LogCategory {
+    LOG_GENERAL,
+    LOG_TIMELINE,
+    LOG_LAYOUT,
+    LOG_INPUT,
+    LOG_RENDER,
+    NUM_LOG_CATEGORIES
+};
+
+#define LOG_ENABLED(level, category) \
+    (LOG_LEVEL >= (level) && log_enabled(category, level))
+
+#define LOG_AT(level, category, ...)                    \
+    do {                                                \
+        if (LOG_ENABLED(level, category)) {             \
+            log_message(level, category, __VA_ARGS__);  \
+        }                                               \
+    } while (0)
+
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#define LOG_WARN(category, ...)  LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define LOG_INFO(category, ...)  LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+
+void init_log();
+void set_log_level(enum LogCategory category, int level);
+bool log_enabled(enum LogCategory category, int level);
+void log_message(int level, enum LogCategory category, char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+int start_async_log(int capacity);
+void stop_async_log();
+
+#endif
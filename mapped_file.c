@@ -0,0 +1,59 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "errors.h"
+#include "mapped_file.h"
+
+int mapFile(const char *filename, struct MappedFile *file) {
+    file->data = NULL;
+    file->size = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        set_error(1, "%s: %s", filename, strerror(errno));
+        return 1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        set_error(1, "%s: %s", filename, strerror(errno));
+        close(fd);
+        return 1;
+    }
+    if (info.st_size > 0) {
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            set_error(1, "%s: %s", filename, strerror(errno));
+            close(fd);
+            return 1;
+        }
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        file->data = data;
+        file->size = info.st_size;
+    }
+    // The mapping keeps the file open
+    close(fd);
+    return 0;
+}
+
+// Drops the pages wholly inside bytes [from, to) from memory. They are
+// read from the file again if touched later.
+void releaseMappedRange(struct MappedFile *file, size_t from, size_t to) {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t start = (from + pageSize - 1) / pageSize * pageSize;
+    size_t end = to / pageSize * pageSize;
+    if (file->data != NULL && end > start) {
+        madvise((char *)file->data + start, end - start, MADV_DONTNEED);
+    }
+}
+
+void unmapFile(struct MappedFile *file) {
+    if (file->data != NULL) {
+        munmap((void *)file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
@@ -0,0 +1,24 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+/*
+
+A whole file mapped read only into memory, so it can be scanned in place
+without being read into a buffer. Pages are only read as they are touched,
+and releaseMappedRange lets a sequential reader give back the ones it is
+done with, so scanning a file of any size takes bounded memory.
+
+*/
+
+struct MappedFile {
+    const char *data; // NULL for an empty file
+    size_t size;
+};
+
+int mapFile(const char *filename, struct MappedFile *file);
+void releaseMappedRange(struct MappedFile *file, size_t from, size_t to);
+void unmapFile(struct MappedFile *file);
+
+#endif
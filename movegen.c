@@ -0,0 +1,602 @@
+#include <stdio.h>
+#include <string.h>
+#include "movegen.h"
+#include "attack_tables.h" // generated by gen_attack_tables.c
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define PEXT_AVAILABLE
+#endif
+
+#define ROW_8  0x00000000000000FFULL
+#define ROW_5  0x00000000FF000000ULL
+#define ROW_4  0x000000FF00000000ULL
+#define ROW_1  0xFF00000000000000ULL
+#define FILE_A 0x0101010101010101ULL
+
+struct CastleRule {
+    uint8_t right;    // CASTLE_* flag
+    uint8_t kingFrom;
+    uint8_t kingTo;
+    uint8_t rookFrom;
+    uint8_t rookTo;
+    uint64_t emptyMask; // squares between king and rook
+};
+
+static const struct CastleRule castleRules[4] = {
+    { CASTLE_WHITE_KING,  60, 62, 63, 61, SQUARE_BIT(61) | SQUARE_BIT(62) },
+    { CASTLE_WHITE_QUEEN, 60, 58, 56, 59, SQUARE_BIT(57) | SQUARE_BIT(58) | SQUARE_BIT(59) },
+    { CASTLE_BLACK_KING,   4,  6,  7,  5, SQUARE_BIT(5) | SQUARE_BIT(6) },
+    { CASTLE_BLACK_QUEEN,  4,  2,  0,  3, SQUARE_BIT(1) | SQUARE_BIT(2) | SQUARE_BIT(3) },
+};
+
+// Castling rights that are gone once anything moves from or to a square.
+static const uint8_t castlingRightsLost[64] = {
+    [0] = CASTLE_BLACK_QUEEN,
+    [4] = CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN,
+    [7] = CASTLE_BLACK_KING,
+    [56] = CASTLE_WHITE_QUEEN,
+    [60] = CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN,
+    [63] = CASTLE_WHITE_KING,
+};
+
+static bool usePextAttacks = false;
+
+bool cpuSupportsPext() {
+#ifdef PEXT_AVAILABLE
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+// Switches sliding attack lookups between magic multiplication and BMI2
+// PEXT indexing. Returns whether PEXT is in use afterwards, which is never
+// the case on a CPU without BMI2.
+bool setPextAttacks(bool enabled) {
+    usePextAttacks = enabled && cpuSupportsPext();
+    return usePextAttacks;
+}
+
+#ifdef PEXT_AVAILABLE
+__attribute__((target("bmi2")))
+static uint64_t pextIndex(uint64_t occupied, uint64_t mask) {
+    return _pext_u64(occupied, mask);
+}
+#endif
+
+uint64_t knightAttacks(int square) {
+    return knightAttackTable[square];
+}
+
+uint64_t kingAttacks(int square) {
+    return kingAttackTable[square];
+}
+
+// Squares a pawn of color on square attacks. White pawns move towards row 0.
+uint64_t pawnAttacks(int square, enum Color color) {
+    return color == White ? whitePawnAttackTable[square] : blackPawnAttackTable[square];
+}
+
+uint64_t bishopAttacks(int square, uint64_t occupied) {
+#ifdef PEXT_AVAILABLE
+    if (usePextAttacks) {
+        return bishopPextAttacks[bishopOffsets[square] + pextIndex(occupied, bishopMasks[square])];
+    }
+#endif
+    uint64_t index = ((occupied & bishopMasks[square]) * bishopMagics[square]) >> bishopShifts[square];
+    return bishopMagicAttacks[bishopOffsets[square] + index];
+}
+
+uint64_t rookAttacks(int square, uint64_t occupied) {
+#ifdef PEXT_AVAILABLE
+    if (usePextAttacks) {
+        return rookPextAttacks[rookOffsets[square] + pextIndex(occupied, rookMasks[square])];
+    }
+#endif
+    uint64_t index = ((occupied & rookMasks[square]) * rookMagics[square]) >> rookShifts[square];
+    return rookMagicAttacks[rookOffsets[square] + index];
+}
+
+bool isSquareAttacked(const struct Board *board, int square, enum Color byColor) {
+    uint64_t attackers = board->colors[byColor];
+    if (pawnAttacks(square, !byColor) & attackers & board->pieceTypes[Pawn]) {
+        return true;
+    }
+    if (knightAttacks(square) & attackers & board->pieceTypes[Knight]) {
+        return true;
+    }
+    if (kingAttacks(square) & attackers & board->pieceTypes[King]) {
+        return true;
+    }
+    uint64_t queens = board->pieceTypes[Queen];
+    if (bishopAttacks(square, board->occupied) & attackers & (board->pieceTypes[Biship] | queens)) {
+        return true;
+    }
+    if (rookAttacks(square, board->occupied) & attackers & (board->pieceTypes[Rook] | queens)) {
+        return true;
+    }
+    return false;
+}
+
+bool isInCheck(const struct Board *board, enum Color color) {
+    int kingSquare = boardKingSquare(board, color);
+    return kingSquare != NO_SQUARE && isSquareAttacked(board, kingSquare, !color);
+}
+
+static inline void addMove(struct MoveList *list, int from, int to, int promotion, int flags) {
+    struct Move *move = &list->moves[list->count++];
+    move->from = from;
+    move->to = to;
+    move->promotion = promotion;
+    move->flags = flags;
+}
+
+static void addPawnMove(struct MoveList *list, int from, int to, int flags, uint64_t promotionRow) {
+    if (SQUARE_BIT(to) & promotionRow) {
+        flags |= MOVE_PROMOTION;
+        addMove(list, from, to, Queen, flags);
+        addMove(list, from, to, Rook, flags);
+        addMove(list, from, to, Biship, flags);
+        addMove(list, from, to, Knight, flags);
+    } else {
+        addMove(list, from, to, Pawn, flags);
+    }
+}
+
+static void generatePawnMoves(const struct Board *board, struct MoveList *list) {
+    enum Color us = board->sideToMove;
+    uint64_t pawns = pieceBits(board, us, Pawn);
+    uint64_t empty = ~board->occupied;
+    uint64_t enemies = board->colors[!us];
+    int forward = us == White ? -8 : 8;
+    uint64_t promotionRow = us == White ? ROW_8 : ROW_1;
+
+    uint64_t singlePushes, doublePushes;
+    if (us == White) {
+        singlePushes = (pawns >> 8) & empty;
+        doublePushes = (singlePushes >> 8) & empty & ROW_4;
+    } else {
+        singlePushes = (pawns << 8) & empty;
+        doublePushes = (singlePushes << 8) & empty & ROW_5;
+    }
+
+    while (singlePushes) {
+        int to = popLsb(&singlePushes);
+        addPawnMove(list, to - forward, to, 0, promotionRow);
+    }
+    while (doublePushes) {
+        int to = popLsb(&doublePushes);
+        addMove(list, to - 2 * forward, to, Pawn, MOVE_DOUBLE_PUSH);
+    }
+
+    uint64_t capturers = pawns;
+    while (capturers) {
+        int from = popLsb(&capturers);
+        uint64_t captures = pawnAttacks(from, us) & enemies;
+        while (captures) {
+            addPawnMove(list, from, popLsb(&captures), MOVE_CAPTURE, promotionRow);
+        }
+    }
+
+    // Only if the pawn that passed over epSquare is really there, so a set
+    // up board with a stray epSquare cannot take a piece that is not
+    int epRow = us == White ? 2 : 5;
+    if (board->epSquare != NO_SQUARE && SQUARE_ROW(board->epSquare) == epRow &&
+        !(board->occupied & SQUARE_BIT(board->epSquare)) &&
+        (pieceBits(board, !us, Pawn) & SQUARE_BIT(board->epSquare - forward))) {
+        uint64_t epCapturers = pawnAttacks(board->epSquare, !us) & pawns;
+        while (epCapturers) {
+            addMove(list, popLsb(&epCapturers), board->epSquare, Pawn, MOVE_CAPTURE | MOVE_EN_PASSANT);
+        }
+    }
+}
+
+static void addTargets(
+    const struct Board *board, struct MoveList *list,
+    int from, uint64_t targets
+) {
+    uint64_t enemies = board->colors[!board->sideToMove];
+    targets &= ~board->colors[board->sideToMove];
+    while (targets) {
+        int to = popLsb(&targets);
+        addMove(list, from, to, Pawn, (SQUARE_BIT(to) & enemies) ? MOVE_CAPTURE : 0);
+    }
+}
+
+// The king and rook must also be where the rights say, since a set up
+// board may claim rights it has no pieces for.
+static void generateCastlingMoves(const struct Board *board, struct MoveList *list) {
+    enum Color us = board->sideToMove;
+    uint8_t rights = board->castling & (us == White
+        ? CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN
+        : CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN);
+    uint64_t kings = pieceBits(board, us, King);
+    uint64_t rooks = pieceBits(board, us, Rook);
+    for (int i = 0; i < 4; i++) {
+        const struct CastleRule *rule = &castleRules[i];
+        if (!(rights & rule->right) || (board->occupied & rule->emptyMask) ||
+            !(kings & SQUARE_BIT(rule->kingFrom)) || !(rooks & SQUARE_BIT(rule->rookFrom))) {
+            continue;
+        }
+        int passSquare = (rule->kingFrom + rule->kingTo) / 2;
+        if (isSquareAttacked(board, rule->kingFrom, !us) ||
+            isSquareAttacked(board, passSquare, !us) ||
+            isSquareAttacked(board, rule->kingTo, !us)) {
+            continue;
+        }
+        addMove(list, rule->kingFrom, rule->kingTo, Pawn, MOVE_CASTLE);
+    }
+}
+
+// Moves that follow the piece movement rules but may leave the mover's
+// king in check.
+void generatePseudoLegalMoves(const struct Board *board, struct MoveList *list) {
+    enum Color us = board->sideToMove;
+    uint64_t occupied = board->occupied;
+    list->count = 0;
+
+    generatePawnMoves(board, list);
+
+    uint64_t knights = pieceBits(board, us, Knight);
+    while (knights) {
+        int from = popLsb(&knights);
+        addTargets(board, list, from, knightAttacks(from));
+    }
+    uint64_t bishops = pieceBits(board, us, Biship) | pieceBits(board, us, Queen);
+    while (bishops) {
+        int from = popLsb(&bishops);
+        addTargets(board, list, from, bishopAttacks(from, occupied));
+    }
+    uint64_t rooks = pieceBits(board, us, Rook) | pieceBits(board, us, Queen);
+    while (rooks) {
+        int from = popLsb(&rooks);
+        addTargets(board, list, from, rookAttacks(from, occupied));
+    }
+    uint64_t kings = pieceBits(board, us, King);
+    while (kings) {
+        int from = popLsb(&kings);
+        addTargets(board, list, from, kingAttacks(from));
+    }
+
+    generateCastlingMoves(board, list);
+}
+
+void generateLegalMoves(const struct Board *board, struct MoveList *list) {
+    struct MoveList pseudoLegal;
+    generatePseudoLegalMoves(board, &pseudoLegal);
+    list->count = 0;
+    for (int i = 0; i < pseudoLegal.count; i++) {
+        // Copying the board is cheaper than unmakeMove for a single probe.
+        struct Board next = *board;
+        applyMove(&next, pseudoLegal.moves[i]);
+        if (!isInCheck(&next, board->sideToMove)) {
+            list->moves[list->count++] = pseudoLegal.moves[i];
+        }
+    }
+}
+
+// Looks up the legal move that takes the piece on srcPos to destPos.
+// promotion picks the piece a pawn reaching the last row becomes.
+bool findLegalMove(
+    const struct Board *board, int srcPos, int destPos,
+    enum PieceType promotion, struct Move *move
+) {
+    if (srcPos < 0 || srcPos >= 64 || destPos < 0 || destPos >= 64) {
+        return false;
+    }
+    // Only the one matching move is checked for leaving the king in check,
+    // since replaying saved moves calls this for every ply
+    struct MoveList list;
+    generatePseudoLegalMoves(board, &list);
+    for (int i = 0; i < list.count; i++) {
+        struct Move candidate = list.moves[i];
+        if (candidate.from == srcPos && candidate.to == destPos &&
+            (!(candidate.flags & MOVE_PROMOTION) || candidate.promotion == promotion)) {
+            struct Board next = *board;
+            applyMove(&next, candidate);
+            if (isInCheck(&next, board->sideToMove)) {
+                return false;
+            }
+            *move = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+static enum PieceType pieceTypeFromSanChar(char c) {
+    switch (c) {
+        case 'N': return Knight;
+        case 'B': return Biship;
+        case 'R': return Rook;
+        case 'Q': return Queen;
+        case 'K': return King;
+        default: return Pawn;
+    }
+}
+
+// Looks up the legal move written in standard algebraic notation, like
+// Nbd7, exd6, e8=Q or O-O, from the length characters at san, which need
+// not end in a 0. Check and annotation marks after it are ignored. Fails
+// if the move is illegal, ambiguous or not SAN.
+//
+// Only the pieces that could have made the move are tried, rather than
+// generating every move, since this is what reading PGN spends its time
+// on.
+bool findSanMove(const struct Board *board, const char *san, int length, struct Move *move) {
+    while (length > 0 && strchr("+#!?", san[length - 1]) != NULL) {
+        length--;
+    }
+    enum Color us = board->sideToMove;
+    if (length >= 3 && (san[0] == 'O' || san[0] == '0')) {
+        int kingFrom = us == White ? 60 : 4;
+        int kingTo = length >= 5 ? kingFrom - 2 : kingFrom + 2;
+        return findLegalMove(board, kingFrom, kingTo, Queen, move) && (move->flags & MOVE_CASTLE);
+    }
+
+    int i = 0;
+    enum PieceType type = pieceTypeFromSanChar(san[0]);
+    if (type != Pawn) {
+        i++;
+    }
+    enum PieceType promotion = Pawn;
+    if (type == Pawn && length >= 3 && pieceTypeFromSanChar(san[length - 1]) != Pawn) {
+        promotion = pieceTypeFromSanChar(san[length - 1]);
+        length -= san[length - 2] == '=' ? 2 : 1;
+    }
+    if (length - i < 2 ||
+        san[length - 2] < 'a' || san[length - 2] > 'h' ||
+        san[length - 1] < '1' || san[length - 1] > '8') {
+        return false;
+    }
+    int to = ('8' - san[length - 1]) * 8 + (san[length - 2] - 'a');
+    uint64_t from = ~0ULL; // squares the disambiguation allows
+    bool capture = false;
+    for (; i < length - 2; i++) {
+        if (san[i] >= 'a' && san[i] <= 'h') {
+            from &= FILE_A << (san[i] - 'a');
+        } else if (san[i] >= '1' && san[i] <= '8') {
+            from &= ROW_8 << (8 * ('8' - san[i]));
+        } else if (san[i] == 'x') {
+            capture = true;
+        } else {
+            return false;
+        }
+    }
+
+    uint64_t enemies = board->colors[!us];
+    if (SQUARE_BIT(to) & board->colors[us]) {
+        return false;
+    }
+    int flags = (SQUARE_BIT(to) & enemies) ? MOVE_CAPTURE : 0;
+    switch (type) {
+        case Knight: from &= knightAttacks(to); break;
+        case Biship: from &= bishopAttacks(to, board->occupied); break;
+        case Rook: from &= rookAttacks(to, board->occupied); break;
+        case Queen: from &= bishopAttacks(to, board->occupied) | rookAttacks(to, board->occupied); break;
+        case King: from &= kingAttacks(to); break;
+        case Pawn: {
+            int forward = us == White ? -8 : 8;
+            bool promotes = SQUARE_BIT(to) & (us == White ? ROW_8 : ROW_1);
+            if (promotes != (promotion != Pawn)) {
+                return false;
+            }
+            if (promotes) {
+                flags |= MOVE_PROMOTION;
+            }
+            if (capture || (from & FILE_A << SQUARE_COL(to)) == 0) {
+                if (to == board->epSquare) {
+                    flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+                } else if (!(flags & MOVE_CAPTURE)) {
+                    return false;
+                }
+                from &= pawnAttacks(to, !us);
+            } else {
+                if (flags & MOVE_CAPTURE) {
+                    return false;
+                }
+                uint64_t pushedFrom = SQUARE_BIT(to - forward);
+                if (!(pushedFrom & board->occupied) &&
+                    (SQUARE_BIT(to) & (us == White ? ROW_4 : ROW_5))) {
+                    // Nothing on the square between, so a double push
+                    pushedFrom = SQUARE_BIT(to - 2 * forward);
+                    flags |= MOVE_DOUBLE_PUSH;
+                }
+                from &= pushedFrom;
+            }
+            break;
+        }
+    }
+    from &= pieceBits(board, us, type);
+
+    bool found = false;
+    while (from) {
+        struct Move candidate = { popLsb(&from), to, promotion, flags };
+        struct Board next = *board;
+        applyMove(&next, candidate);
+        if (!isInCheck(&next, us)) {
+            if (found) {
+                return false;
+            }
+            *move = candidate;
+            found = true;
+        }
+    }
+    return found;
+}
+
+static const struct CastleRule *castleRuleFor(int kingTo) {
+    for (int i = 0; i < 4; i++) {
+        if (castleRules[i].kingTo == kingTo) {
+            return &castleRules[i];
+        }
+    }
+    return NULL;
+}
+
+// Plays move on board and records what unmakeMove needs to take it back.
+// A move from an empty square, which no move generator makes, leaves the
+// board as it is rather than corrupting it.
+void makeMove(struct Board *board, struct Move move, struct UndoState *undo) {
+    enum Color us = board->sideToMove;
+    enum Piece piece = boardPieceAt(board, move.from);
+
+    undo->hash = board->hash;
+    undo->castling = board->castling;
+    undo->epSquare = board->epSquare;
+    undo->halfmoveClock = board->halfmoveClock;
+    undo->moved = piece;
+    undo->captured = Blank;
+    if (piece == Blank) {
+        return;
+    }
+
+    board->hash ^= boardStateHash(board);
+    board->halfmoveClock++;
+    if (move.flags & MOVE_EN_PASSANT) {
+        int capturedSquare = move.to + (us == White ? 8 : -8);
+        undo->captured = MAKE_PIECE(!us, Pawn);
+        boardTogglePiece(board, capturedSquare, undo->captured);
+        board->halfmoveClock = 0;
+    } else if (move.flags & MOVE_CAPTURE) {
+        undo->captured = boardPieceAt(board, move.to);
+        if (undo->captured != Blank) {
+            boardTogglePiece(board, move.to, undo->captured);
+        }
+        board->halfmoveClock = 0;
+    }
+
+    boardTogglePiece(board, move.from, piece);
+    if (move.flags & MOVE_PROMOTION) {
+        boardTogglePiece(board, move.to, MAKE_PIECE(us, move.promotion));
+    } else {
+        boardTogglePiece(board, move.to, piece);
+    }
+    if (PIECE_TYPE(piece) == Pawn) {
+        board->halfmoveClock = 0;
+    }
+
+    if (move.flags & MOVE_CASTLE) {
+        const struct CastleRule *rule = castleRuleFor(move.to);
+        enum Piece rook = MAKE_PIECE(us, Rook);
+        boardTogglePiece(board, rule->rookFrom, rook);
+        boardTogglePiece(board, rule->rookTo, rook);
+    }
+
+    board->castling &= ~(castlingRightsLost[move.from] | castlingRightsLost[move.to]);
+    board->epSquare = NO_SQUARE;
+    if ((move.flags & MOVE_DOUBLE_PUSH) && canCaptureEnPassant(board, (move.from + move.to) / 2, !us)) {
+        board->epSquare = (move.from + move.to) / 2;
+    }
+    if (us == Black) {
+        board->fullmoveNumber++;
+    }
+    board->sideToMove = !us;
+    board->hash ^= boardStateHash(board);
+}
+
+// Takes back move, which must be the last move made on board.
+void unmakeMove(struct Board *board, struct Move move, const struct UndoState *undo) {
+    if (undo->moved == Blank) {
+        // makeMove did not play it
+        return;
+    }
+    enum Color us = !board->sideToMove;
+
+    if (move.flags & MOVE_CASTLE) {
+        const struct CastleRule *rule = castleRuleFor(move.to);
+        enum Piece rook = MAKE_PIECE(us, Rook);
+        boardToggleBits(board, rule->rookTo, rook);
+        boardToggleBits(board, rule->rookFrom, rook);
+    }
+
+    if (move.flags & MOVE_PROMOTION) {
+        boardToggleBits(board, move.to, MAKE_PIECE(us, move.promotion));
+    } else {
+        boardToggleBits(board, move.to, undo->moved);
+    }
+    boardToggleBits(board, move.from, undo->moved);
+
+    if (move.flags & MOVE_EN_PASSANT) {
+        boardToggleBits(board, move.to + (us == White ? 8 : -8), undo->captured);
+    } else if (undo->captured != Blank) {
+        boardToggleBits(board, move.to, undo->captured);
+    }
+
+    if (us == Black) {
+        board->fullmoveNumber--;
+    }
+    board->sideToMove = us;
+    board->castling = undo->castling;
+    board->epSquare = undo->epSquare;
+    board->halfmoveClock = undo->halfmoveClock;
+    board->hash = undo->hash;
+}
+
+// Plays move for callers that never take it back.
+void applyMove(struct Board *board, struct Move move) {
+    struct UndoState undo;
+    makeMove(board, move, &undo);
+}
+
+UT_icd undo_entry_icd = { sizeof(struct UndoEntry), NULL, NULL, NULL };
+
+// Plays move on board and pushes it onto undoStack, an array of
+// struct UndoEntry's.
+void pushMove(struct Board *board, UT_array *undoStack, struct Move move) {
+    struct UndoEntry entry;
+    entry.move = move;
+    makeMove(board, move, &entry.undo);
+    utarray_push_back(undoStack, &entry);
+}
+
+// Takes back the move on top of undoStack. Returns false if it is empty.
+bool popMove(struct Board *board, UT_array *undoStack) {
+    struct UndoEntry *entry = utarray_back(undoStack);
+    if (entry == NULL) {
+        return false;
+    }
+    unmakeMove(board, entry->move, &entry->undo);
+    utarray_pop_back(undoStack);
+    return true;
+}
+
+static uint64_t perftRecursive(struct Board *board, int depth) {
+    struct MoveList list;
+    generateLegalMoves(board, &list);
+    if (depth == 1) {
+        return list.count;
+    }
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        struct UndoState undo;
+        makeMove(board, list.moves[i], &undo);
+        nodes += perftRecursive(board, depth - 1);
+        unmakeMove(board, list.moves[i], &undo);
+    }
+    return nodes;
+}
+
+// Counts the leaf nodes of the legal move tree, depth plies deep.
+uint64_t perft(const struct Board *board, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    struct Board scratch = *board;
+    return perftRecursive(&scratch, depth);
+}
+
+// Long algebraic notation, e.g. "e2e4" or "e7e8q".
+void moveToString(struct Move move, char str[6]) {
+    str[0] = 'a' + SQUARE_COL(move.from);
+    str[1] = '8' - SQUARE_ROW(move.from);
+    str[2] = 'a' + SQUARE_COL(move.to);
+    str[3] = '8' - SQUARE_ROW(move.to);
+    if (move.flags & MOVE_PROMOTION) {
+        str[4] = "pnbrkq"[move.promotion];
+        str[5] = '\0';
+    } else {
+        str[4] = '\0';
+    }
+}
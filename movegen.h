@@ -0,0 +1,73 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "board.h"
+#include "utarray.h"
+
+#define MOVE_CAPTURE     1
+#define MOVE_DOUBLE_PUSH 2
+#define MOVE_EN_PASSANT  4
+#define MOVE_CASTLE      8
+#define MOVE_PROMOTION   16
+
+#define MAX_MOVES 256
+
+// 32 bits. A struct Move of all zeros is never a legal move, so it can
+// stand for "no move".
+struct Move {
+    uint8_t from;
+    uint8_t to;
+    uint8_t promotion; // enum PieceType, only meaningful with MOVE_PROMOTION
+    uint8_t flags;     // MOVE_* flags
+};
+
+// Everything makeMove overwrites that the move itself does not say.
+struct UndoState {
+    uint64_t hash;
+    uint8_t moved;         // enum Piece that was on the from square
+    uint8_t captured;      // enum Piece, Blank if nothing was captured
+    uint8_t castling;
+    int8_t epSquare;
+    uint8_t halfmoveClock;
+};
+
+struct UndoEntry {
+    struct Move move;
+    struct UndoState undo;
+};
+
+extern UT_icd undo_entry_icd;
+
+struct MoveList {
+    struct Move moves[MAX_MOVES];
+    int count;
+};
+
+bool cpuSupportsPext();
+bool setPextAttacks(bool enabled);
+uint64_t knightAttacks(int square);
+uint64_t kingAttacks(int square);
+uint64_t pawnAttacks(int square, enum Color color);
+uint64_t bishopAttacks(int square, uint64_t occupied);
+uint64_t rookAttacks(int square, uint64_t occupied);
+bool isSquareAttacked(const struct Board *board, int square, enum Color byColor);
+bool isInCheck(const struct Board *board, enum Color color);
+
+void generatePseudoLegalMoves(const struct Board *board, struct MoveList *list);
+void generateLegalMoves(const struct Board *board, struct MoveList *list);
+bool findLegalMove(
+    const struct Board *board, int srcPos, int destPos,
+    enum PieceType promotion, struct Move *move);
+bool findSanMove(const struct Board *board, const char *san, int length, struct Move *move);
+void makeMove(struct Board *board, struct Move move, struct UndoState *undo);
+void unmakeMove(struct Board *board, struct Move move, const struct UndoState *undo);
+void applyMove(struct Board *board, struct Move move);
+void pushMove(struct Board *board, UT_array *undoStack, struct Move move);
+bool popMove(struct Board *board, UT_array *undoStack);
+
+uint64_t perft(const struct Board *board, int depth);
+void moveToString(struct Move move, char str[6]);
+
+#endif
@@ -0,0 +1,134 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "errors.h"
+#include "board.h"
+#include "movegen.h"
+
+/*
+
+Move generator benchmark. Counts the leaf nodes of the legal move tree for
+the standard perft positions and checks them against the known counts.
+
+    ./build_perft
+    ./perft.bin                  run the standard positions
+    ./perft.bin "<fen>" <depth>  per-move node counts for one position
+
+Sliding attacks use BMI2 PEXT lookups when the CPU has them. Pass
+--no-pext first to measure the magic multiply lookups instead.
+
+*/
+
+struct PerftPosition {
+    char *name;
+    char *fen;
+    int depth;
+    uint64_t nodes;
+};
+
+// https://www.chessprogramming.org/Perft_Results
+const struct PerftPosition perftPositions[] = {
+    { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609 },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+    { "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624 },
+    { "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333 },
+    { "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+    { "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 },
+};
+
+double currentSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int runStandardPositions() {
+    int numPositions = sizeof(perftPositions) / sizeof(perftPositions[0]);
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0;
+    int failures = 0;
+
+    for (int i = 0; i < numPositions; i++) {
+        const struct PerftPosition *position = &perftPositions[i];
+        struct Board board;
+        if (boardFromFen(&board, position->fen) != 0) {
+            finalize_error();
+            return 1;
+        }
+        double start = currentSeconds();
+        uint64_t nodes = perft(&board, position->depth);
+        double seconds = currentSeconds() - start;
+        bool passed = nodes == position->nodes;
+        if (!passed) {
+            failures++;
+        }
+        printf(
+            "%-12s depth %d  nodes %10llu  %8.3fs  %12.0f nps  %s\n",
+            position->name, position->depth, (unsigned long long)nodes,
+            seconds, nodes / seconds, passed ? "ok" : "MISMATCH"
+        );
+        totalNodes += nodes;
+        totalSeconds += seconds;
+    }
+
+    printf(
+        "total        nodes %llu  %.3fs  %.0f nps\n",
+        (unsigned long long)totalNodes, totalSeconds, totalNodes / totalSeconds
+    );
+    if (failures > 0) {
+        printf("%d position(s) did not match the expected node count.\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+int runDivide(char *fen, int depth) {
+    struct Board board;
+    CALL(boardFromFen(&board, fen));
+
+    struct MoveList list;
+    generateLegalMoves(&board, &list);
+    uint64_t totalNodes = 0;
+    double start = currentSeconds();
+    for (int i = 0; i < list.count; i++) {
+        struct Board next = board;
+        applyMove(&next, list.moves[i]);
+        uint64_t nodes = perft(&next, depth - 1);
+        char moveString[6];
+        moveToString(list.moves[i], moveString);
+        printf("%s: %llu\n", moveString, (unsigned long long)nodes);
+        totalNodes += nodes;
+    }
+    double seconds = currentSeconds() - start;
+    printf(
+        "\nnodes %llu  %.3fs  %.0f nps\n",
+        (unsigned long long)totalNodes, seconds, totalNodes / seconds
+    );
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bool pext = true;
+    if (argc > 1 && strcmp(argv[1], "--no-pext") == 0) {
+        pext = false;
+        argc--;
+        argv++;
+    }
+    pext = setPextAttacks(pext);
+    printf("sliding attacks: %s lookup\n", pext ? "pext" : "magic");
+
+    if (argc == 1) {
+        return runStandardPositions();
+    }
+    if (argc == 3 && atoi(argv[2]) > 0) {
+        if (runDivide(argv[1], atoi(argv[2])) != 0) {
+            finalize_error();
+            return 1;
+        }
+        return 0;
+    }
+    fprintf(stderr, "usage: %s [--no-pext] [\"<fen>\" <depth>]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,456 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "errors.h"
+#include "log.h"
+#include "utarray.h"
+#include "board.h"
+#include "movegen.h"
+#include "mapped_file.h"
+#include "pgn.h"
+
+// Bytes parsed between giving the pages behind them back
+#define PGN_RELEASE_INTERVAL (64 * 1024 * 1024)
+
+// Passes a part of the game on, unless the game is being skipped, and
+// starts skipping it if the handler gives up.
+#define HANDLE(name, ...) \
+    if (!skipping && handler->name != NULL && handler->name(handler->context, __VA_ARGS__) != 0) { \
+        skipping = true; \
+    }
+#define HANDLE_EVENT(name) \
+    if (!skipping && handler->name != NULL && handler->name(handler->context) != 0) { \
+        skipping = true; \
+    }
+
+#define CHAR_SPACE    1
+#define CHAR_WORD_END 2 // ends a move or result
+
+static const uint8_t charClasses[256] = {
+    [' '] = CHAR_SPACE | CHAR_WORD_END,
+    ['\n'] = CHAR_SPACE | CHAR_WORD_END,
+    ['\r'] = CHAR_SPACE | CHAR_WORD_END,
+    ['\t'] = CHAR_SPACE | CHAR_WORD_END,
+    ['\f'] = CHAR_SPACE | CHAR_WORD_END,
+    ['\v'] = CHAR_SPACE | CHAR_WORD_END,
+    ['('] = CHAR_WORD_END, [')'] = CHAR_WORD_END,
+    ['{'] = CHAR_WORD_END, ['}'] = CHAR_WORD_END,
+    ['['] = CHAR_WORD_END, [']'] = CHAR_WORD_END,
+    [';'] = CHAR_WORD_END, ['$'] = CHAR_WORD_END,
+    ['!'] = CHAR_WORD_END, ['?'] = CHAR_WORD_END,
+};
+
+static inline bool isSpace(char c) {
+    return charClasses[(uint8_t)c] & CHAR_SPACE;
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool endsWord(char c) {
+    return charClasses[(uint8_t)c] & CHAR_WORD_END;
+}
+
+static const char *skipLine(const char *p, const char *end) {
+    const char *newline = memchr(p, '\n', end - p);
+    return newline != NULL ? newline : end;
+}
+
+static bool tokenEquals(struct PgnToken token, const char *string) {
+    return token.length == (int)strlen(string) && memcmp(token.text, string, token.length) == 0;
+}
+
+// The NAG for a move suffix like !? , or 0 if it is not one.
+static int suffixNag(struct PgnToken suffix) {
+    static const char *suffixes[] = { "!", "?", "!!", "??", "!?", "?!" };
+    for (int i = 0; i < 6; i++) {
+        if (tokenEquals(suffix, suffixes[i])) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Parses the game starting at or after text, up to end, passing its parts
+// on to handler. Returns where the game ended, or NULL if there were no
+// more games.
+const char *parsePgnGame(const char *text, const char *end, const struct PgnHandler *handler) {
+    const char *p = text;
+    bool started = false;
+    bool inMovetext = false;
+    bool skipping = false;
+    int depth = 0;
+    struct PgnToken result = { p, 0 };
+
+    while (p < end) {
+        char c = *p;
+        if (isSpace(c)) {
+            p++;
+            continue;
+        }
+        if (c == '%' && (p == text || p[-1] == '\n')) {
+            // Escaped line
+            p = skipLine(p, end);
+            continue;
+        }
+        if (!started) {
+            started = true;
+            HANDLE_EVENT(beginGame);
+        }
+
+        if (c == '[') {
+            if (inMovetext) {
+                // The next game's tags: this one had no result
+                break;
+            }
+            p++;
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+            struct PgnToken name = { p, 0 };
+            while (p < end && !isSpace(*p) && *p != '"' && *p != ']') {
+                p++;
+            }
+            name.length = p - name.text;
+            while (p < end && *p != '"' && *p != ']' && *p != '\n') {
+                p++;
+            }
+            struct PgnToken value = { p, 0 };
+            if (p < end && *p == '"') {
+                value.text = ++p;
+                while (p < end && *p != '"' && *p != '\n') {
+                    p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+                }
+                value.length = p - value.text;
+            }
+            p = skipLine(p, end);
+            HANDLE(tag, name, value);
+            continue;
+        }
+        inMovetext = true;
+        if (c == '{') {
+            struct PgnToken comment = { p + 1, 0 };
+            const char *close = memchr(comment.text, '}', end - comment.text);
+            p = close != NULL ? close + 1 : end;
+            comment.length = (close != NULL ? close : end) - comment.text;
+            HANDLE(comment, comment);
+        } else if (c == ';') {
+            struct PgnToken comment = { p + 1, 0 };
+            p = skipLine(p, end);
+            comment.length = p - comment.text;
+            HANDLE(comment, comment);
+        } else if (c == '(') {
+            p++;
+            depth++;
+            HANDLE_EVENT(beginVariation);
+        } else if (c == ')') {
+            p++;
+            if (depth > 0) {
+                depth--;
+                HANDLE_EVENT(endVariation);
+            }
+        } else if (c == '$') {
+            int nag = 0;
+            for (p++; p < end && isDigit(*p); p++) {
+                nag = nag * 10 + (*p - '0');
+            }
+            HANDLE(nag, nag);
+        } else if (c == '*') {
+            result.text = p++;
+            result.length = 1;
+            break;
+        } else if (c == '.' || c == ']' || c == '}' || c == '"') {
+            // Stray
+            p++;
+        } else {
+            struct PgnToken word = { p, 0 };
+            if (isDigit(c)) {
+                while (p < end && isDigit(*p)) {
+                    p++;
+                }
+                if (p < end && *p == '.') {
+                    // Move number
+                    while (p < end && *p == '.') {
+                        p++;
+                    }
+                    continue;
+                }
+            }
+            while (p < end && !endsWord(*p)) {
+                p++;
+            }
+            word.length = p - word.text;
+            if (isDigit(c) &&
+                (tokenEquals(word, "1-0") || tokenEquals(word, "0-1") || tokenEquals(word, "1/2-1/2"))) {
+                result = word;
+                break;
+            }
+            if (word.length > 0) {
+                HANDLE(move, word);
+            }
+            if (p < end && (*p == '!' || *p == '?')) {
+                struct PgnToken suffix = { p, 0 };
+                while (p < end && (*p == '!' || *p == '?')) {
+                    p++;
+                }
+                suffix.length = p - suffix.text;
+                int nag = suffixNag(suffix);
+                if (nag != 0) {
+                    HANDLE(nag, nag);
+                }
+            }
+        }
+    }
+
+    if (!started) {
+        return NULL;
+    }
+    if (handler->endGame != NULL) {
+        handler->endGame(handler->context, result, !skipping);
+    }
+    return p;
+}
+
+/*
+
+Building a timeline
+
+*/
+
+// The position after ply index of timeline
+struct PgnCursor {
+    struct TimelineNode *timeline;
+    int index;
+};
+
+UT_icd pgn_cursor_icd = { sizeof(struct PgnCursor), NULL, NULL, NULL };
+
+struct PgnImport {
+    struct TimelineNode **root;
+    struct PgnCursor cursor;  // where the next move is played from
+    struct Board board;       // at cursor
+    UT_array *variations;     // struct PgnCursor's to go back to at the end of each variation
+    struct PgnImportStats *stats;
+    bool rootIsStart;         // the root is the usual starting position
+    bool hasFen;              // the game being read has a FEN tag
+};
+
+static bool sameMove(struct Move a, struct Move b) {
+    return a.from == b.from && a.to == b.to && a.promotion == b.promotion && a.flags == b.flags;
+}
+
+static bool atGameStart(struct PgnImport *import) {
+    return import->cursor.timeline->parent == NULL && import->cursor.index == 0;
+}
+
+static void moveCursor(struct PgnImport *import, struct TimelineNode *timeline, int index) {
+    import->cursor.timeline = timeline;
+    import->cursor.index = index;
+    getTimelineBoard(timeline, index, &import->board);
+}
+
+static int importBeginGame(void *context) {
+    struct PgnImport *import = context;
+    utarray_clear(import->variations);
+    moveCursor(import, *import->root, 0);
+    import->hasFen = false;
+    return 0;
+}
+
+static int importTag(void *context, struct PgnToken name, struct PgnToken value) {
+    struct PgnImport *import = context;
+    if (!tokenEquals(name, "FEN")) {
+        return 0;
+    }
+    // Only games from the position the root starts with fit in the tree
+    struct Board board;
+    import->hasFen = true;
+    if (parseFen(&board, value.text, value.text + value.length) == NULL) {
+        return 1;
+    }
+    return board.hash != import->board.hash;
+}
+
+// After timeline was split after index and head took the plies up to it,
+// points the cursors saved on those plies at head, and the rest at their
+// new indices.
+static void fixSavedCursors(
+    struct PgnImport *import, struct TimelineNode *timeline, int index, struct TimelineNode *head
+) {
+    int numSaved = utarray_len(import->variations);
+    for (int i = 0; i < numSaved; i++) {
+        struct PgnCursor *saved = utarray_eltptr(import->variations, i);
+        if (saved->timeline != timeline) {
+            continue;
+        }
+        if (saved->index <= index) {
+            saved->timeline = head;
+        } else {
+            saved->index -= index + 1;
+        }
+    }
+}
+
+static int importMove(void *context, struct PgnToken san) {
+    struct PgnImport *import = context;
+    struct Move move;
+    if (!import->hasFen && !import->rootIsStart) {
+        // Without a FEN tag the game starts from the usual position, not
+        // the one the root was set up with
+        return 1;
+    }
+    if (!findSanMove(&import->board, san.text, san.length, &move)) {
+        LOG_DEBUG(LOG_TIMELINE, "Skipping a game at illegal move %.*s", san.length, san.text);
+        return 1;
+    }
+    applyMove(&import->board, move);
+
+    // Follow the branch that already plays this move, if there is one
+    struct TimelineNode *timeline = import->cursor.timeline;
+    int index = import->cursor.index;
+    if (index < timeline->length - 1) {
+        if (sameMove(timelineMove(timeline, index + 1), move)) {
+            import->cursor.index++;
+            return 0;
+        }
+    } else {
+        int numChildren = utarray_len(timeline->children);
+        for (int i = 0; i < numChildren; i++) {
+            struct TimelineNode *child = timelineChild(timeline, i);
+            if (sameMove(timelineMove(child, 0), move)) {
+                import->cursor.timeline = child;
+                import->cursor.index = 0;
+                return 0;
+            }
+        }
+    }
+
+    struct TimelineNode *head;
+    struct TimelineNode *added = addPly(import->root, timeline, index, &import->board, move, &head);
+    if (head != NULL) {
+        fixSavedCursors(import, timeline, index, head);
+    }
+    import->cursor.timeline = added;
+    import->cursor.index = added->length - 1;
+    import->stats->plies++;
+    return 0;
+}
+
+static int importNag(void *context, int nag) {
+    struct PgnImport *import = context;
+    struct PgnCursor *cursor = &import->cursor;
+    if (!atGameStart(import) && nag < 256 && timelineNag(cursor->timeline, cursor->index) == 0) {
+        setTimelineNag(cursor->timeline, cursor->index, nag);
+    }
+    return 0;
+}
+
+static int importComment(void *context, struct PgnToken text) {
+    struct PgnImport *import = context;
+    (void)text;
+    import->stats->comments++;
+    return 0;
+}
+
+// A variation replaces the move before it, so it is played from the ply
+// before the cursor.
+static int importBeginVariation(void *context) {
+    struct PgnImport *import = context;
+    if (atGameStart(import)) {
+        return 1;
+    }
+    utarray_push_back(import->variations, &import->cursor);
+    struct TimelineNode *timeline = import->cursor.timeline;
+    if (import->cursor.index > 0) {
+        moveCursor(import, timeline, import->cursor.index - 1);
+    } else {
+        moveCursor(import, timeline->parent, timeline->parent->length - 1);
+    }
+    return 0;
+}
+
+static int importEndVariation(void *context) {
+    struct PgnImport *import = context;
+    struct PgnCursor *saved = utarray_back(import->variations);
+    moveCursor(import, saved->timeline, saved->index);
+    utarray_pop_back(import->variations);
+    return 0;
+}
+
+static void importEndGame(void *context, struct PgnToken result, bool completed) {
+    struct PgnImport *import = context;
+    (void)result;
+    if (completed) {
+        import->stats->games++;
+    } else {
+        import->stats->skippedGames++;
+    }
+}
+
+static void initImport(
+    struct PgnImport *import, struct PgnHandler *handler,
+    struct TimelineNode **root, struct PgnImportStats *stats
+) {
+    import->root = root;
+    import->stats = stats;
+    utarray_new(import->variations, &pgn_cursor_icd);
+    struct Board start;
+    struct Board rootBoard;
+    initBoard(&start);
+    getTimelineBoard(*root, 0, &rootBoard);
+    import->rootIsStart = rootBoard.hash == start.hash;
+    import->hasFen = false;
+    struct PgnHandler importHandler = {
+        import, importBeginGame, importTag, importMove, importNag, importComment,
+        importBeginVariation, importEndVariation, importEndGame
+    };
+    *handler = importHandler;
+}
+
+// Adds the games in text, up to end, to the timeline at *root like
+// importPgn does, adding to stats.
+void importPgnGames(
+    const char *text, const char *end, struct TimelineNode **root, struct PgnImportStats *stats
+) {
+    struct PgnImport import;
+    struct PgnHandler handler;
+    initImport(&import, &handler, root, stats);
+    for (const char *p = text; p != NULL && p < end; ) {
+        p = parsePgnGame(p, end, &handler);
+    }
+    stats->bytes += end - text;
+    utarray_free(import.variations);
+}
+
+// Adds the games in filename to the timeline at *root, whose first ply
+// must be the position they start from. *root changes if the root is
+// split to branch off it.
+int importPgn(const char *filename, struct TimelineNode **root, struct PgnImportStats *stats) {
+    struct MappedFile file;
+    CALL(mapFile(filename, &file));
+    memset(stats, 0, sizeof(*stats));
+    stats->bytes = file.size;
+
+    struct PgnImport import;
+    struct PgnHandler handler;
+    initImport(&import, &handler, root, stats);
+    const char *end = file.data + file.size;
+    const char *p = file.data;
+    size_t released = 0;
+    while (p != NULL && p < end) {
+        p = parsePgnGame(p, end, &handler);
+        size_t parsed = (p != NULL ? p : end) - file.data;
+        if (parsed - released >= PGN_RELEASE_INTERVAL) {
+            releaseMappedRange(&file, released, parsed);
+            released = parsed;
+        }
+    }
+
+    utarray_free(import.variations);
+    unmapFile(&file);
+    LOG_INFO(LOG_TIMELINE, "Imported %ld game(s) from %s, skipped %ld, %ld new plies",
+        stats->games, filename, stats->skippedGames, stats->plies);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "timeline.h"
+
+/*
+
+Reads PGN, the Portable Game Notation, straight out of a mapped file.
+parsePgnGame tokenizes one game and hands each part of it to a struct
+PgnHandler as a token pointing into the text, so nothing is copied or
+allocated while parsing.
+
+importPgn builds a timeline from the games of a file. Every game starts
+from the first ply of the root, and a game or variation that plays the
+same moves as one already read follows the same branch, so games sharing
+an opening share its plies. Variations become branches off the ply they
+replace. A move's first NAG, or its !, ? etc., is kept on its ply;
+comments are counted but not kept, since nothing shows them. Games that
+start from another position than the root's are skipped: a game with a
+FEN tag must match the root, and one without it needs the root to be the
+usual starting position. A game with an illegal move is only read up to
+it.
+
+*/
+
+struct PgnToken {
+    const char *text; // into the PGN, not 0 terminated
+    int length;
+};
+
+// Any of the callbacks may be NULL. A callback returning non-zero gives up
+// on the rest of the game: nothing else is passed on until endGame.
+struct PgnHandler {
+    void *context;
+    int (*beginGame)(void *context);
+    int (*tag)(void *context, struct PgnToken name, struct PgnToken value); // value keeps its \ escapes
+    int (*move)(void *context, struct PgnToken san);
+    int (*nag)(void *context, int nag);
+    int (*comment)(void *context, struct PgnToken text);
+    int (*beginVariation)(void *context);
+    int (*endVariation)(void *context);
+    void (*endGame)(void *context, struct PgnToken result, bool completed); // result is empty if missing
+};
+
+struct PgnImportStats {
+    long games;
+    long skippedGames;
+    long plies;    // added to the timeline
+    long comments;
+    size_t bytes;
+};
+
+const char *parsePgnGame(const char *text, const char *end, const struct PgnHandler *handler);
+void importPgnGames(
+    const char *text, const char *end, struct TimelineNode **root, struct PgnImportStats *stats);
+int importPgn(const char *filename, struct TimelineNode **root, struct PgnImportStats *stats);
+
+#endif
@@ -0,0 +1,204 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "errors.h"
+#include "board.h"
+#include "movegen.h"
+#include "timeline.h"
+#include "mapped_file.h"
+#include "pgn.h"
+#include "pgn_index.h"
+
+/*
+
+PGN reader benchmark. Reads a PGN file three times: tokenizing only,
+tokenizing and looking up every move on a board, and importing it into a
+timeline, and prints how fast each went. Then indexes it on one thread and
+on every core, reads the index openPgnIndex saves next to it back, and
+opens its last game from the index.
+
+    ./build_pgn_bench
+    ./pgn_bench.bin <file.pgn> [threads]
+
+*/
+
+struct BenchCounts {
+    long games;
+    long moves;
+    long failedGames;
+    struct Board board;
+};
+
+double currentSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int countMove(void *context, struct PgnToken san) {
+    struct BenchCounts *counts = context;
+    counts->moves++;
+    return 0;
+}
+
+int resetBoard(void *context) {
+    struct BenchCounts *counts = context;
+    initBoard(&counts->board);
+    return 0;
+}
+
+int playMove(void *context, struct PgnToken san) {
+    struct BenchCounts *counts = context;
+    struct Move move;
+    if (!findSanMove(&counts->board, san.text, san.length, &move)) {
+        return 1;
+    }
+    applyMove(&counts->board, move);
+    counts->moves++;
+    return 0;
+}
+
+// Variations would need the board from before the move they replace
+int skipVariation(void *context) {
+    return 1;
+}
+
+void countGame(void *context, struct PgnToken result, bool completed) {
+    struct BenchCounts *counts = context;
+    counts->games++;
+    if (!completed) {
+        counts->failedGames++;
+    }
+}
+
+void printRate(const char *name, size_t bytes, long moves, double seconds) {
+    printf(
+        "%-10s %8.3fs  %8.1f MB/s  %12.0f moves/s\n",
+        name, seconds, bytes / seconds / 1e6, moves / seconds
+    );
+}
+
+int runPass(const char *name, struct MappedFile *file, struct PgnHandler *handler) {
+    struct BenchCounts *counts = handler->context;
+    const char *end = file->data + file->size;
+    double start = currentSeconds();
+    for (const char *p = file->data; p != NULL && p < end; ) {
+        p = parsePgnGame(p, end, handler);
+    }
+    double seconds = currentSeconds() - start;
+    printRate(name, file->size, counts->moves, seconds);
+    return 0;
+}
+
+int runBenchmark(const char *filename) {
+    struct MappedFile file;
+    CALL(mapFile(filename, &file));
+
+    struct BenchCounts counts;
+    memset(&counts, 0, sizeof(counts));
+    struct PgnHandler tokenize = { &counts, NULL, NULL, countMove, NULL, NULL, NULL, NULL, countGame };
+    runPass("tokenize", &file, &tokenize);
+    printf("           %ld game(s), %ld move(s)\n", counts.games, counts.moves);
+
+    memset(&counts, 0, sizeof(counts));
+    struct PgnHandler play = {
+        &counts, resetBoard, NULL, playMove, NULL, NULL, skipVariation, NULL, countGame
+    };
+    runPass("moves", &file, &play);
+    printf("           %ld game(s) stopped at an illegal move or a variation\n", counts.failedGames);
+    unmapFile(&file);
+
+    struct TimelineNode *root = newTimeline(NULL);
+    struct Board board;
+    struct Move noMove = { 0 };
+    initBoard(&board);
+    pushPly(root, &board, noMove);
+    struct PgnImportStats stats;
+    double start = currentSeconds();
+    CALL(importPgn(filename, &root, &stats));
+    double seconds = currentSeconds() - start;
+    printRate("import", stats.bytes, stats.plies, seconds);
+    printf(
+        "           %ld game(s), %ld skipped, %ld new plies, %d positions\n",
+        stats.games, stats.skippedGames, stats.plies, numPositions()
+    );
+    freeTimeline(root);
+    return 0;
+}
+
+int runIndexPass(const char *filename, int numThreads, struct PgnIndex *index) {
+    double start = currentSeconds();
+    CALL(indexPgn(filename, numThreads, index));
+    double seconds = currentSeconds() - start;
+    char name[32];
+    snprintf(name, sizeof(name), "index x%d", numThreads);
+    printf(
+        "%-10s %8.3fs  %8.1f MB/s  %12.0f games/s\n",
+        name, seconds, index->file.size / seconds / 1e6, index->numGames / seconds
+    );
+    return 0;
+}
+
+// Reads the saved index, saving it first if there is none for the file.
+int runSavedIndexPass(const char *filename, struct PgnIndex *parallel) {
+    struct PgnIndex saved;
+    CALL(openPgnIndex(filename, 0, &saved));
+    freePgnIndex(&saved);
+    double start = currentSeconds();
+    CALL(openPgnIndex(filename, 0, &saved));
+    double seconds = currentSeconds() - start;
+    bool same = saved.numGames == parallel->numGames &&
+        memcmp(saved.games, parallel->games, saved.numGames * sizeof(struct PgnGameEntry)) == 0;
+    printf("saved      %8.6fs  %s\n", seconds, same ? "same index" : "INDEX MISMATCH");
+    freePgnIndex(&saved);
+    return same ? 0 : 1;
+}
+
+int runIndexBenchmark(const char *filename, int numThreads) {
+    struct PgnIndex serial, parallel;
+    CALL(runIndexPass(filename, 1, &serial));
+    CALL(runIndexPass(filename, numThreads, &parallel));
+    bool same = serial.numGames == parallel.numGames &&
+        memcmp(serial.games, parallel.games, serial.numGames * sizeof(struct PgnGameEntry)) == 0;
+    printf("           %ld game(s), %s\n", parallel.numGames, same ? "same index" : "INDEX MISMATCH");
+    freePgnIndex(&serial);
+    if (runSavedIndexPass(filename, &parallel) != 0) {
+        same = false;
+    }
+
+    if (parallel.numGames > 0) {
+        long last = parallel.numGames - 1;
+        struct TimelineNode *root;
+        double start = currentSeconds();
+        CALL(openPgnGame(&parallel, last, &root));
+        double seconds = currentSeconds() - start;
+        struct PgnToken white = pgnGameTag(&parallel, last, PGN_TAG_WHITE);
+        struct PgnToken black = pgnGameTag(&parallel, last, PGN_TAG_BLACK);
+        printf(
+            "open       %8.6fs  game %ld, %.*s - %.*s\n",
+            seconds, last + 1, white.length, white.text, black.length, black.text
+        );
+        freeTimeline(root);
+    }
+    freePgnIndex(&parallel);
+    return same ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "usage: %s <file.pgn> [threads]\n", argv[0]);
+        return 1;
+    }
+    int numThreads = argc == 3 ? atoi(argv[2]) : 0;
+    if (numThreads <= 0) {
+        numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (runBenchmark(argv[1]) != 0 || runIndexBenchmark(argv[1], numThreads) != 0) {
+        finalize_error();
+        return 1;
+    }
+    return 0;
+}
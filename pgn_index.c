@@ -0,0 +1,458 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "errors.h"
+#include "log.h"
+#include "utarray.h"
+#include "board.h"
+#include "pgn_index.h"
+
+#define MIN_CHUNK_SIZE (1024 * 1024)
+// More chunks than threads, so that threads that finish early take more
+#define CHUNKS_PER_THREAD 8
+#define PGN_INDEX_VERSION 1
+#define PGN_INDEX_PATH_MAX_SIZE 1024
+
+static const char indexMagic[4] = { 'G', 'C', 'I', 'X' };
+
+// Starts a saved index, followed by its entries. The size and modification
+// time of the PGN file it was made from say whether it still fits it.
+struct PgnIndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entrySize; // sizeof(struct PgnGameEntry) of the build that wrote it
+    uint32_t reserved;
+    uint64_t pgnSize;
+    int64_t pgnModified; // seconds since the epoch
+    uint64_t numGames;
+};
+
+static const char *rosterTagNames[PGN_NUM_ROSTER_TAGS] = {
+    "Event", "Site", "Date", "Round", "White", "Black", "Result"
+};
+
+UT_icd pgn_game_entry_icd = { sizeof(struct PgnGameEntry), NULL, NULL, NULL };
+
+struct IndexChunk {
+    const char *start; // where its first game starts
+    const char *end;   // where the next chunk's first game starts
+    UT_array *games;   // struct PgnGameEntry's of the games starting in it
+};
+
+struct IndexJob {
+    const struct MappedFile *file;
+    struct IndexChunk *chunks;
+    int numChunks;
+    int nextChunk;
+    // Guards nextChunk
+    pthread_mutex_t lock;
+};
+
+// A worker's view of the game it is parsing
+struct GameScan {
+    const char *text; // where the game's text starts
+    struct PgnGameEntry entry;
+};
+
+static bool isTag(struct PgnToken name, const char *tag) {
+    return name.length == (int)strlen(tag) && memcmp(name.text, tag, name.length) == 0;
+}
+
+static int scanBeginGame(void *context) {
+    struct GameScan *scan = context;
+    memset(&scan->entry, 0, sizeof(scan->entry));
+    return 0;
+}
+
+static int scanTag(void *context, struct PgnToken name, struct PgnToken value) {
+    struct GameScan *scan = context;
+    for (int i = 0; i < PGN_NUM_ROSTER_TAGS; i++) {
+        ptrdiff_t offset = value.text - scan->text;
+        if (isTag(name, rosterTagNames[i]) && offset <= UINT16_MAX && value.length <= UINT16_MAX) {
+            scan->entry.tags[i].offset = offset;
+            scan->entry.tags[i].length = value.length;
+            return 0;
+        }
+    }
+    if (isTag(name, "FEN")) {
+        // Checked when the game is opened
+        scan->entry.flags |= PGN_GAME_FEN;
+    }
+    return 0;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// The first line starting with [ after a blank line, from from on, or end
+// if there is none.
+static const char *findGameStart(const char *from, const char *end) {
+    const char *p = from;
+    while (p < end) {
+        const char *newline = memchr(p, '\n', end - p);
+        if (newline == NULL) {
+            return end;
+        }
+        p = newline + 1;
+        if (p < end && *p == '[') {
+            const char *lineEnd = newline;
+            while (lineEnd > from && isBlank(lineEnd[-1])) {
+                lineEnd--;
+            }
+            if (lineEnd > from && lineEnd[-1] == '\n') {
+                return p;
+            }
+        }
+    }
+    return end;
+}
+
+static void indexChunk(struct IndexJob *job, struct IndexChunk *chunk) {
+    const char *data = job->file->data;
+    const char *end = data + job->file->size;
+    struct GameScan scan;
+    // Only the tags are looked at. The moves are skipped over, not played,
+    // so a game ends at its result or at the next game's tags.
+    struct PgnHandler handler = { &scan, scanBeginGame, scanTag, NULL, NULL, NULL, NULL, NULL, NULL };
+
+    utarray_new(chunk->games, &pgn_game_entry_icd);
+    const char *p = chunk->start;
+    while (p < chunk->end) {
+        scan.text = p;
+        // The last game may run on past the chunk's end
+        const char *next = parsePgnGame(p, end, &handler);
+        if (next == NULL) {
+            break;
+        }
+        scan.entry.offset = p - data;
+        scan.entry.length = next - p;
+        utarray_push_back(chunk->games, &scan.entry);
+        p = next;
+        while (p < chunk->end && (isBlank(*p) || *p == '\n')) {
+            p++;
+        }
+    }
+    releaseMappedRange((struct MappedFile *)job->file, chunk->start - data, chunk->end - data);
+}
+
+static void *indexWorker(void *arg) {
+    struct IndexJob *job = arg;
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        int chunk = job->nextChunk++;
+        pthread_mutex_unlock(&job->lock);
+        if (chunk >= job->numChunks) {
+            return NULL;
+        }
+        indexChunk(job, &job->chunks[chunk]);
+    }
+}
+
+// Splits the file into chunks starting at games.
+static int planChunks(const struct MappedFile *file, int numThreads, struct IndexChunk **chunks) {
+    size_t chunkSize = file->size / (numThreads * CHUNKS_PER_THREAD);
+    if (chunkSize < MIN_CHUNK_SIZE) {
+        chunkSize = MIN_CHUNK_SIZE;
+    }
+    *chunks = malloc((file->size / chunkSize + 1) * sizeof(struct IndexChunk));
+    int numChunks = 0;
+    const char *end = file->data + file->size;
+    for (const char *start = file->data; start < end; ) {
+        const char *next = (size_t)(end - start) > chunkSize ? findGameStart(start + chunkSize, end) : end;
+        (*chunks)[numChunks].start = start;
+        (*chunks)[numChunks].end = next;
+        numChunks++;
+        start = next;
+    }
+    return numChunks;
+}
+
+// Joins the chunks' games in file order, dropping any that start inside
+// the game before them, which only happens after a wrong boundary.
+static void joinChunks(struct IndexChunk *chunks, int numChunks, struct PgnIndex *index) {
+    long numGames = 0;
+    for (int i = 0; i < numChunks; i++) {
+        numGames += utarray_len(chunks[i].games);
+    }
+    index->games = malloc((numGames > 0 ? numGames : 1) * sizeof(struct PgnGameEntry));
+    index->numGames = 0;
+    uint64_t parsedTo = 0;
+    for (int i = 0; i < numChunks; i++) {
+        int numChunkGames = utarray_len(chunks[i].games);
+        for (int j = 0; j < numChunkGames; j++) {
+            struct PgnGameEntry *entry = utarray_eltptr(chunks[i].games, j);
+            if (entry->offset < parsedTo) {
+                continue;
+            }
+            index->games[index->numGames++] = *entry;
+            parsedTo = entry->offset + entry->length;
+        }
+        utarray_free(chunks[i].games);
+    }
+    if (index->numGames < numGames) {
+        LOG_WARN(LOG_TIMELINE, "Dropped %ld game(s) read across a chunk boundary",
+            numGames - index->numGames);
+    }
+}
+
+// Indexes the games in filename on numThreads threads, counting the
+// calling one, or one per core if numThreads is 0.
+int indexPgn(const char *filename, int numThreads, struct PgnIndex *index) {
+    CALL(mapFile(filename, &index->file));
+    if (numThreads <= 0) {
+        numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = numThreads > 0 ? numThreads : 1;
+    }
+
+    struct IndexJob job;
+    job.file = &index->file;
+    job.numChunks = planChunks(&index->file, numThreads, &job.chunks);
+    job.nextChunk = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    int numWorkers = numThreads - 1 < job.numChunks ? numThreads - 1 : job.numChunks;
+    pthread_t *workers = malloc((numWorkers > 0 ? numWorkers : 1) * sizeof(pthread_t));
+    int started = 0;
+    for (; started < numWorkers; started++) {
+        if (pthread_create(&workers[started], NULL, indexWorker, &job) != 0) {
+            // The threads that did start, and this one, take the rest
+            LOG_WARN(LOG_TIMELINE, "Could only start %d indexing thread(s)", started);
+            break;
+        }
+    }
+    indexWorker(&job);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    pthread_mutex_destroy(&job.lock);
+
+    joinChunks(job.chunks, job.numChunks, index);
+    free(job.chunks);
+    LOG_INFO(LOG_TIMELINE, "Indexed %ld game(s) in %s: %d chunk(s) on %d thread(s)",
+        index->numGames, filename, job.numChunks, started + 1);
+    return 0;
+}
+
+// Whether every entry, and its tags, lies inside a file of pgnSize bytes,
+// so a damaged index cannot send openPgnGame outside the mapping.
+static bool validEntries(const struct PgnGameEntry *games, long numGames, uint64_t pgnSize) {
+    for (long i = 0; i < numGames; i++) {
+        const struct PgnGameEntry *entry = &games[i];
+        if (entry->offset > pgnSize || entry->length > pgnSize - entry->offset) {
+            return false;
+        }
+        for (int tag = 0; tag < PGN_NUM_ROSTER_TAGS; tag++) {
+            if (entry->tags[tag].offset + entry->tags[tag].length > entry->length) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Reads the entries saved at path into index if they were made from a file
+// of the size and modification time in info. Returns whether they were.
+static bool loadSavedIndex(const char *path, const struct stat *info, struct PgnIndex *index) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    struct PgnIndexHeader header;
+    bool loaded = fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, indexMagic, sizeof(indexMagic)) == 0 &&
+        header.version == PGN_INDEX_VERSION &&
+        header.entrySize == sizeof(struct PgnGameEntry) &&
+        header.pgnSize == (uint64_t)info->st_size &&
+        header.pgnModified == (int64_t)info->st_mtime &&
+        // Every game takes at least a byte
+        header.numGames <= header.pgnSize;
+    if (loaded) {
+        index->games = malloc((header.numGames > 0 ? header.numGames : 1) * sizeof(struct PgnGameEntry));
+        index->numGames = header.numGames;
+        loaded = fread(index->games, sizeof(struct PgnGameEntry), header.numGames, f) == header.numGames &&
+            fgetc(f) == EOF &&
+            validEntries(index->games, index->numGames, header.pgnSize);
+        if (!loaded) {
+            free(index->games);
+            index->games = NULL;
+            index->numGames = 0;
+        }
+    }
+    fclose(f);
+    return loaded;
+}
+
+// Saves the entries of index to path, for a file of the size and
+// modification time in info.
+static bool saveIndex(const char *path, const struct stat *info, const struct PgnIndex *index) {
+    struct PgnIndexHeader header;
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.version = PGN_INDEX_VERSION;
+    header.entrySize = sizeof(struct PgnGameEntry);
+    header.reserved = 0;
+    header.pgnSize = info->st_size;
+    header.pgnModified = info->st_mtime;
+    header.numGames = index->numGames;
+
+    // Renamed into place like a session, so a crash leaves no half an index
+    char tempPath[PGN_INDEX_PATH_MAX_SIZE + 4];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE *f = fopen(tempPath, "wb");
+    bool saved = f != NULL &&
+        fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(index->games, sizeof(struct PgnGameEntry), index->numGames, f) == (size_t)index->numGames &&
+        fflush(f) == 0 &&
+        fsync(fileno(f)) == 0;
+    if (f != NULL && fclose(f) != 0) {
+        saved = false;
+    }
+    if (!saved || rename(tempPath, path) != 0) {
+        remove(tempPath);
+        return false;
+    }
+    return true;
+}
+
+static bool sameFileVersion(const struct stat *a, const struct stat *b) {
+    return a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+// Like indexPgn, but reads the index saved next to filename, as
+// filename.index, if filename has not changed since it was saved. If it
+// has, or there is none, filename is indexed and the index saved for next
+// time.
+int openPgnIndex(const char *filename, int numThreads, struct PgnIndex *index) {
+    char path[PGN_INDEX_PATH_MAX_SIZE];
+    struct stat before;
+    if (snprintf(path, sizeof(path), "%s.index", filename) >= (int)sizeof(path) ||
+        stat(filename, &before) != 0) {
+        return indexPgn(filename, numThreads, index);
+    }
+    if (loadSavedIndex(path, &before, index)) {
+        if (mapFile(filename, &index->file) != 0) {
+            free(index->games);
+            index->games = NULL;
+            index->numGames = 0;
+            return 1;
+        }
+        if (index->file.size == (size_t)before.st_size) {
+            LOG_INFO(LOG_TIMELINE, "Read the index of %ld game(s) in %s from %s",
+                index->numGames, filename, path);
+            return 0;
+        }
+        // Changed after the stat: index what was mapped
+        freePgnIndex(index);
+    }
+
+    CALL(indexPgn(filename, numThreads, index));
+    struct stat after;
+    // Only saved if it is certainly the index of the file stat saw
+    if (stat(filename, &after) == 0 && sameFileVersion(&before, &after) &&
+        index->file.size == (size_t)before.st_size) {
+        if (!saveIndex(path, &before, index)) {
+            LOG_WARN(LOG_TIMELINE, "Could not save the index to %s, it is made again next time", path);
+        }
+    }
+    return 0;
+}
+
+// One of the tags every PGN game should have, or an empty token if it is
+// missing.
+struct PgnToken pgnGameTag(const struct PgnIndex *index, long game, enum PgnRosterTag tag) {
+    const struct PgnGameEntry *entry = &index->games[game];
+    struct PgnToken value = {
+        index->file.data + entry->offset + entry->tags[tag].offset,
+        entry->tags[tag].length
+    };
+    return value;
+}
+
+static int findFen(void *context, struct PgnToken name, struct PgnToken value) {
+    struct PgnToken *fen = context;
+    if (isTag(name, "FEN")) {
+        *fen = value;
+    }
+    return 0;
+}
+
+// The tags are all before the first move
+static int stopAtMove(void *context, struct PgnToken san) {
+    (void)context;
+    (void)san;
+    return 1;
+}
+
+// Sets board to the position game starts from.
+static int gameStartBoard(const struct PgnIndex *index, long game, struct Board *board) {
+    if (game < 0 || game >= index->numGames) {
+        set_error(1, "There is no game %ld, only %ld", game + 1, index->numGames);
+        return 1;
+    }
+    const struct PgnGameEntry *entry = &index->games[game];
+    const char *text = index->file.data + entry->offset;
+    if (entry->flags & PGN_GAME_FEN) {
+        struct PgnToken fen = { text, 0 };
+        struct PgnHandler handler = { &fen, NULL, findFen, stopAtMove, NULL, NULL, NULL, NULL, NULL };
+        parsePgnGame(text, text + entry->length, &handler);
+        if (parseFen(board, fen.text, fen.text + fen.length) == NULL) {
+            set_error(1, "Bad FEN in game %ld: %.*s", game + 1, fen.length, fen.text);
+            return 1;
+        }
+    } else {
+        initBoard(board);
+    }
+    return 0;
+}
+
+// Sets *root to a new timeline holding game, the first being 0, and its
+// variations.
+int openPgnGame(const struct PgnIndex *index, long game, struct TimelineNode **root) {
+    struct Board board;
+    CALL(gameStartBoard(index, game, &board));
+    const struct PgnGameEntry *entry = &index->games[game];
+    const char *text = index->file.data + entry->offset;
+    const char *end = text + entry->length;
+    struct TimelineNode *timeline = newTimeline(NULL);
+    struct Move noMove = { 0 };
+    pushPly(timeline, &board, noMove);
+
+    struct PgnImportStats stats;
+    memset(&stats, 0, sizeof(stats));
+    importPgnGames(text, end, &timeline, &stats);
+    *root = timeline;
+    LOG_INFO(LOG_TIMELINE, "Opened game %ld: %ld plies", game + 1, stats.plies);
+    return 0;
+}
+
+// Adds game to the timeline at *root like importPgn does, so it shares
+// the plies of any game already there. Fails if the game does not start
+// from the position the root does.
+int importPgnGame(const struct PgnIndex *index, long game, struct TimelineNode **root) {
+    struct Board start;
+    struct Board rootBoard;
+    CALL(gameStartBoard(index, game, &start));
+    getTimelineBoard(*root, 0, &rootBoard);
+    if (start.hash != rootBoard.hash) {
+        set_error(1, "Game %ld does not start from the timeline's first position", game + 1);
+        return 1;
+    }
+    const struct PgnGameEntry *entry = &index->games[game];
+    const char *text = index->file.data + entry->offset;
+    struct PgnImportStats stats;
+    memset(&stats, 0, sizeof(stats));
+    importPgnGames(text, text + entry->length, root, &stats);
+    LOG_INFO(LOG_TIMELINE, "Imported game %ld: %ld new plies", game + 1, stats.plies);
+    return 0;
+}
+
+void freePgnIndex(struct PgnIndex *index) {
+    free(index->games);
+    index->games = NULL;
+    index->numGames = 0;
+    unmapFile(&index->file);
+}
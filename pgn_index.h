@@ -0,0 +1,68 @@
+#ifndef PGN_INDEX_H
+#define PGN_INDEX_H
+
+#include <stdint.h>
+#include "mapped_file.h"
+#include "pgn.h"
+#include "timeline.h"
+
+/*
+
+An index of every game in a PGN file, so that any one of them can be
+opened without parsing the ones before it. indexPgn splits the mapped file
+into chunks at game boundaries and scans them on a pool of threads for
+where each game's tags start and where it ends, at its result or the next
+game's tags. Moves are skipped over, not played: opening a game only needs
+its bytes. The index keeps the file mapped and its entries point into it
+rather than copying the tags.
+
+openPgnIndex saves the entries next to the file, as <file>.index, and
+reads them back instead of scanning the file again as long as the file
+keeps the size and modification time it had.
+
+A chunk boundary is a line starting with [ after a blank line, which is
+where the tags of a game start in any export format. A boundary that was
+wrong (inside a comment, say) is caught when the chunks are joined, by
+dropping games that start inside the previous chunk's last game.
+
+*/
+
+enum PgnRosterTag {
+    PGN_TAG_EVENT,
+    PGN_TAG_SITE,
+    PGN_TAG_DATE,
+    PGN_TAG_ROUND,
+    PGN_TAG_WHITE,
+    PGN_TAG_BLACK,
+    PGN_TAG_RESULT,
+    PGN_NUM_ROSTER_TAGS
+};
+
+#define PGN_GAME_FEN 1 // has a FEN tag, to start from a set up position
+
+struct PgnTagSpan {
+    uint16_t offset; // from the start of the game's text
+    uint16_t length; // 0 if the tag is missing
+};
+
+struct PgnGameEntry {
+    uint64_t offset; // of the game's text in the file
+    uint32_t length;
+    uint8_t flags;   // PGN_GAME_* flags
+    struct PgnTagSpan tags[PGN_NUM_ROSTER_TAGS];
+};
+
+struct PgnIndex {
+    struct MappedFile file;
+    struct PgnGameEntry *games;
+    long numGames;
+};
+
+int indexPgn(const char *filename, int numThreads, struct PgnIndex *index);
+int openPgnIndex(const char *filename, int numThreads, struct PgnIndex *index);
+struct PgnToken pgnGameTag(const struct PgnIndex *index, long game, enum PgnRosterTag tag);
+int openPgnGame(const struct PgnIndex *index, long game, struct TimelineNode **root);
+int importPgnGame(const struct PgnIndex *index, long game, struct TimelineNode **root);
+void freePgnIndex(struct PgnIndex *index);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include "positions.h"
+
+#define MIN_TABLE_CAPACITY 1024
+
+// A slot with no references is empty.
+struct PositionSlot {
+    uint64_t hash;
+    int refCount; // plies in all timelines that reach this position
+};
+
+// Open addressing with linear probing. capacity is a power of two and the
+// table is kept at most half full.
+struct PositionTable {
+    struct PositionSlot *slots;
+    int capacity;
+    int count;
+};
+
+static struct PositionTable positionTable = { NULL, 0, 0 };
+
+// Slot holding hash, or the empty slot where it would go.
+static int findSlot(uint64_t hash) {
+    int mask = positionTable.capacity - 1;
+    int index = hash & mask;
+    while (positionTable.slots[index].refCount != 0 && positionTable.slots[index].hash != hash) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+static void growPositionTable() {
+    struct PositionSlot *oldSlots = positionTable.slots;
+    int oldCapacity = positionTable.capacity;
+    positionTable.capacity = oldCapacity == 0 ? MIN_TABLE_CAPACITY : oldCapacity * 2;
+    positionTable.slots = calloc(positionTable.capacity, sizeof(struct PositionSlot));
+    for (int i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].refCount != 0) {
+            positionTable.slots[findSlot(oldSlots[i].hash)] = oldSlots[i];
+        }
+    }
+    free(oldSlots);
+}
+
+// Takes a reference to the position with hash, adding it if it is new.
+void internPosition(uint64_t hash) {
+    if (2 * (positionTable.count + 1) > positionTable.capacity) {
+        growPositionTable();
+    }
+    struct PositionSlot *slot = &positionTable.slots[findSlot(hash)];
+    if (slot->refCount == 0) {
+        slot->hash = hash;
+        positionTable.count++;
+    }
+    slot->refCount++;
+}
+
+// Plies that reach the position with hash, 0 if none do.
+int positionRefCount(uint64_t hash) {
+    if (positionTable.count == 0) {
+        return 0;
+    }
+    return positionTable.slots[findSlot(hash)].refCount;
+}
+
+// Empties a slot, shifting later entries of the probe run back so that
+// lookups never stop early at the hole.
+static void removeSlot(int hole) {
+    int mask = positionTable.capacity - 1;
+    for (int i = (hole + 1) & mask; positionTable.slots[i].refCount != 0; i = (i + 1) & mask) {
+        int home = positionTable.slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            positionTable.slots[hole] = positionTable.slots[i];
+            hole = i;
+        }
+    }
+    positionTable.slots[hole].refCount = 0;
+    positionTable.count--;
+}
+
+void releasePosition(uint64_t hash) {
+    int index = findSlot(hash);
+    positionTable.slots[index].refCount--;
+    if (positionTable.slots[index].refCount == 0) {
+        removeSlot(index);
+    }
+}
+
+int numPositions() {
+    return positionTable.count;
+}
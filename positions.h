@@ -0,0 +1,30 @@
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+
+Every position reached in a timeline is counted here, keyed by its Zobrist
+hash, so branches that transpose into the same position can be told apart
+from ones that merely look alike on screen. The plies of all timelines are
+the edges of a DAG over these positions: two plies are the same node iff
+they reach the same hash, and a hash with more than one reference is a
+merge point.
+
+Only the hashes and their reference counts are kept, not boards: a ply's
+board is replayed from the keyframes of its timeline (see timeline.h), so
+the table costs a few bytes per distinct position instead of a struct
+Board per ply. The hash covers pieces, side to move, castling rights and
+en passant square, and two positions with the same 64 bit hash are taken
+to be the same one.
+
+*/
+
+void internPosition(uint64_t hash);
+void releasePosition(uint64_t hash);
+int positionRefCount(uint64_t hash);
+int numPositions();
+
+#endif
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <GL/glew.h>
+#include "log.h"
+#include "program_cache.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+#define CACHE_PATH_MAX_SIZE 64
+
+static const char cacheMagic[4] = { 'G', 'L', 'C', 'P' };
+
+// What comes before the binary in a cache file
+struct CacheHeader {
+    char magic[4];
+    uint32_t binaryLength;
+    uint64_t key;
+    GLenum binaryFormat;
+};
+
+static uint64_t hashBytes(uint64_t hash, const void *bytes, size_t length) {
+    const unsigned char *p = bytes;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hashes string and the terminating 0, so consecutive strings can not
+// run together.
+static uint64_t hashString(uint64_t hash, const char *string) {
+    if (string == NULL) {
+        string = "";
+    }
+    return hashBytes(hash, string, strlen(string) + 1);
+}
+
+static bool programBinarySupported() {
+    if (!GLEW_ARB_get_program_binary) {
+        return false;
+    }
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    return numFormats > 0;
+}
+
+static void cachePath(uint64_t key, char path[CACHE_PATH_MAX_SIZE]) {
+    snprintf(path, CACHE_PATH_MAX_SIZE, "%s/%016llx.bin",
+        PROGRAM_CACHE_DIR, (unsigned long long)key);
+}
+
+uint64_t programCacheKey(char **sources, int numSources) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = hashString(hash, (const char *)glGetString(GL_VENDOR));
+    hash = hashString(hash, (const char *)glGetString(GL_RENDERER));
+    hash = hashString(hash, (const char *)glGetString(GL_VERSION));
+    for (int i = 0; i < numSources; i++) {
+        hash = hashString(hash, sources[i]);
+    }
+    return hash;
+}
+
+// Asks the driver to keep program's binary retrievable. Call before
+// linking it.
+void prepareProgramForCache(GLuint program) {
+    if (programBinarySupported()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+// Loads the binary cached under key into program. Returns whether
+// program is now linked; if not, compile and link it from source.
+bool loadCachedProgram(uint64_t key, GLuint program) {
+    if (!programBinarySupported()) {
+        return false;
+    }
+    char path[CACHE_PATH_MAX_SIZE];
+    cachePath(key, path);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        LOG_DEBUG(LOG_RENDER, "program cache miss: %s", path);
+        return false;
+    }
+    struct CacheHeader header;
+    void *binary = NULL;
+    bool loaded = false;
+    if (fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+        header.key == key) {
+        binary = malloc(header.binaryLength);
+        if (binary != NULL && fread(binary, 1, header.binaryLength, f) == header.binaryLength) {
+            glProgramBinary(program, header.binaryFormat, binary, header.binaryLength);
+            GLint linked;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            loaded = linked;
+        }
+    }
+    free(binary);
+    fclose(f);
+    if (loaded) {
+        LOG_INFO(LOG_RENDER, "program cache hit: %s", path);
+    } else {
+        LOG_WARN(LOG_RENDER, "program cache entry rejected: %s", path);
+    }
+    return loaded;
+}
+
+// Writes linked program's binary to the cache under key. Failing to is
+// logged and otherwise ignored, since the cache only saves time.
+void saveCachedProgram(uint64_t key, GLuint program) {
+    if (!programBinarySupported()) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    struct CacheHeader header;
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.key = key;
+    void *binary = malloc(length);
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &header.binaryFormat, binary);
+    header.binaryLength = written;
+
+    if (mkdir(PROGRAM_CACHE_DIR, 0755) != 0 && errno != EEXIST) {
+        LOG_WARN(LOG_RENDER, "could not create %s: %s", PROGRAM_CACHE_DIR, strerror(errno));
+        free(binary);
+        return;
+    }
+    // Written under another name and renamed into place, so a reader never
+    // sees half a file
+    char path[CACHE_PATH_MAX_SIZE];
+    char tempPath[CACHE_PATH_MAX_SIZE + 4];
+    cachePath(key, path);
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE *f = fopen(tempPath, "wb");
+    bool saved = f != NULL &&
+        fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(binary, 1, written, f) == (size_t)written;
+    if (f != NULL && fclose(f) != 0) {
+        saved = false;
+    }
+    if (saved && rename(tempPath, path) == 0) {
+        LOG_INFO(LOG_RENDER, "program cached: %s, %d bytes", path, (int)written);
+    } else {
+        LOG_WARN(LOG_RENDER, "could not write %s", path);
+        remove(tempPath);
+    }
+    free(binary);
+}
@@ -0,0 +1,33 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+/*
+
+An on-disk cache of linked program binaries, so relaunching skips GLSL
+compiles, which dominate startup on software rasterizers.
+
+A program is keyed by a hash of the driver's vendor, renderer and version
+strings and of its shader sources, so a driver update or a shader edit
+misses and recompiles. Drivers can still refuse a binary they wrote
+themselves; loadCachedProgram then reports a miss and the caller compiles
+from source as if there were no cache. Without ARB_get_program_binary
+every lookup misses and nothing is written.
+
+Entries live in PROGRAM_CACHE_DIR, relative to the working directory like
+the shaders are. Deleting it is always safe.
+
+*/
+
+#define PROGRAM_CACHE_DIR "shader_cache"
+
+// sources may hold NULLs, for stages the program does not have.
+uint64_t programCacheKey(char **sources, int numSources);
+void prepareProgramForCache(GLuint program);
+bool loadCachedProgram(uint64_t key, GLuint program);
+void saveCachedProgram(uint64_t key, GLuint program);
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "errors.h"
+#include "log.h"
+#include "utarray.h"
+#include "mapped_file.h"
+#include "session.h"
+
+#define SESSION_VERSION 3 // 3: en passant squares only where a pawn can capture
+#define SESSION_PATH_MAX_SIZE 1024
+
+static const char sessionMagic[4] = { 'G', 'C', 'S', 'N' };
+
+struct SessionHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t boardSize; // sizeof(struct Board) of the build that wrote it
+    uint32_t keyframeInterval;
+    uint32_t numNodes;
+    uint32_t numPlies;
+    uint32_t numKeyframes;
+    uint32_t currentNode;
+    int32_t currentTimestamp;
+    uint32_t journalSequence; // of the last journal record the session includes
+};
+
+struct SessionNode {
+    int32_t parent;        // index in the table, -1 for the root
+    uint32_t firstPly;     // into the moves and NAGs
+    uint32_t length;
+    uint32_t firstKeyframe;
+};
+
+// Followed by the nodes, the moves, the NAGs, padding up to a multiple of
+// 8 bytes and the keyframes.
+struct SessionLayout {
+    size_t nodes;
+    size_t moves;
+    size_t nags;
+    size_t keyframes;
+    size_t size;
+};
+
+UT_icd session_node_icd = { sizeof(struct SessionNode), NULL, NULL, NULL };
+UT_icd session_move_icd = { sizeof(struct Move), NULL, NULL, NULL };
+UT_icd session_nag_icd = { sizeof(uint8_t), NULL, NULL, NULL };
+UT_icd session_keyframe_icd = { sizeof(struct Board), NULL, NULL, NULL };
+
+static void sessionLayout(const struct SessionHeader *header, struct SessionLayout *layout) {
+    layout->nodes = sizeof(struct SessionHeader);
+    layout->moves = layout->nodes + (size_t)header->numNodes * sizeof(struct SessionNode);
+    layout->nags = layout->moves + (size_t)header->numPlies * sizeof(struct Move);
+    layout->keyframes = (layout->nags + header->numPlies + 7) / 8 * 8;
+    layout->size = layout->keyframes + (size_t)header->numKeyframes * header->boardSize;
+}
+
+static int numKeyframes(int length, int interval) {
+    return (length + interval - 1) / interval;
+}
+
+static void collectNode(struct SessionSnapshot *snapshot, struct TimelineNode *timeline, int parent) {
+    struct SessionNode node;
+    int index = utarray_len(snapshot->nodes);
+    node.parent = parent;
+    node.firstPly = utarray_len(snapshot->moves);
+    node.length = timeline->length;
+    node.firstKeyframe = utarray_len(snapshot->keyframes);
+    utarray_push_back(snapshot->nodes, &node);
+    if (timeline == snapshot->current) {
+        snapshot->currentNode = index;
+    }
+
+    for (int i = 0; i < timeline->length; i++) {
+        struct Move move = timelineMove(timeline, i);
+        uint8_t nag = timelineNag(timeline, i);
+        utarray_push_back(snapshot->moves, &move);
+        utarray_push_back(snapshot->nags, &nag);
+    }
+    for (int i = 0; i < timeline->length; i += SESSION_KEYFRAME_INTERVAL) {
+        struct Board board;
+        peekTimelineBoard(timeline, i, &board);
+        utarray_push_back(snapshot->keyframes, &board);
+    }
+
+    int numChildren = utarray_len(timeline->children);
+    for (int i = 0; i < numChildren; i++) {
+        collectNode(snapshot, timelineChild(timeline, i), index);
+    }
+}
+
+// Copies what saving the tree under root needs out of it, so that it can
+// be written on another thread while the tree changes. currentTimestamp
+// of current is the ply being looked at, and journalSequence the last
+// journal record the tree includes.
+void collectSession(
+    struct SessionSnapshot *snapshot, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp, uint32_t journalSequence
+) {
+    utarray_new(snapshot->nodes, &session_node_icd);
+    utarray_new(snapshot->moves, &session_move_icd);
+    utarray_new(snapshot->nags, &session_nag_icd);
+    utarray_new(snapshot->keyframes, &session_keyframe_icd);
+    snapshot->current = current;
+    snapshot->currentNode = 0;
+    snapshot->currentTimestamp = currentTimestamp;
+    snapshot->journalSequence = journalSequence;
+    collectNode(snapshot, root, -1);
+    // Only needed while collecting
+    snapshot->current = NULL;
+}
+
+void freeSessionSnapshot(struct SessionSnapshot *snapshot) {
+    utarray_free(snapshot->nodes);
+    utarray_free(snapshot->moves);
+    utarray_free(snapshot->nags);
+    utarray_free(snapshot->keyframes);
+}
+
+static bool writeArray(FILE *f, UT_array *array) {
+    size_t count = utarray_len(array);
+    return count == 0 || fwrite(array->d, array->icd.sz, count, f) == count;
+}
+
+// Writes snapshot to filename, and makes sure it is on disk before it
+// replaces the last one. Touches no timeline, so any thread can call it.
+int writeSession(const char *filename, const struct SessionSnapshot *snapshot) {
+    struct SessionHeader header;
+    memcpy(header.magic, sessionMagic, sizeof(sessionMagic));
+    header.version = SESSION_VERSION;
+    header.boardSize = sizeof(struct Board);
+    header.keyframeInterval = SESSION_KEYFRAME_INTERVAL;
+    header.numNodes = utarray_len(snapshot->nodes);
+    header.numPlies = utarray_len(snapshot->moves);
+    header.numKeyframes = utarray_len(snapshot->keyframes);
+    header.currentNode = snapshot->currentNode;
+    header.currentTimestamp = snapshot->currentTimestamp;
+    header.journalSequence = snapshot->journalSequence;
+    struct SessionLayout layout;
+    sessionLayout(&header, &layout);
+    static const char padding[8] = { 0 };
+    size_t paddingSize = layout.keyframes - layout.nags - header.numPlies;
+
+    // Written under another name and renamed into place, so a crash while
+    // saving leaves the last session whole
+    char tempPath[SESSION_PATH_MAX_SIZE];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", filename);
+    FILE *f = fopen(tempPath, "wb");
+    bool saved = f != NULL &&
+        fwrite(&header, sizeof(header), 1, f) == 1 &&
+        writeArray(f, snapshot->nodes) &&
+        writeArray(f, snapshot->moves) &&
+        writeArray(f, snapshot->nags) &&
+        fwrite(padding, 1, paddingSize, f) == paddingSize &&
+        writeArray(f, snapshot->keyframes) &&
+        fflush(f) == 0 &&
+        fsync(fileno(f)) == 0;
+    if (f != NULL && fclose(f) != 0) {
+        saved = false;
+    }
+    if (!saved || rename(tempPath, filename) != 0) {
+        remove(tempPath);
+        set_error(1, "Could not write %s", filename);
+        return 1;
+    }
+    LOG_INFO(LOG_TIMELINE, "Saved %u plies in %u branches to %s, %zu bytes",
+        header.numPlies, header.numNodes, filename, layout.size);
+    return 0;
+}
+
+// Compares everything but the padding.
+static bool sameBoard(const struct Board *a, const struct Board *b) {
+    return memcmp(a->pieceTypes, b->pieceTypes, sizeof(a->pieceTypes)) == 0 &&
+        memcmp(a->colors, b->colors, sizeof(a->colors)) == 0 &&
+        a->occupied == b->occupied &&
+        a->sideToMove == b->sideToMove &&
+        a->castling == b->castling &&
+        a->epSquare == b->epSquare &&
+        a->halfmoveClock == b->halfmoveClock &&
+        a->fullmoveNumber == b->fullmoveNumber &&
+        a->hash == b->hash;
+}
+
+// Whether every saved move is the legal move it says it is, from the
+// board the plies before it lead to, and every keyframe the board its
+// moves lead to. Plies are replayed from the keyframes when first looked
+// up, and movegen trusts the boards and moves it is given, so a corrupt
+// file must not get that far. The first keyframe of the root, which
+// nothing leads to, has to be a board parseFen could have set up.
+static bool validMoves(
+    const struct MappedFile *file, const struct SessionHeader *header, const struct SessionLayout *layout
+) {
+    const struct SessionNode *nodes = (const struct SessionNode *)(file->data + layout->nodes);
+    const struct Move *moves = (const struct Move *)(file->data + layout->moves);
+    const struct Board *keyframes = (const struct Board *)(file->data + layout->keyframes);
+    const struct Move noMove = { 0 };
+    // The board after the last ply of each node, which its children follow
+    struct Board *lastBoards = malloc(header->numNodes * sizeof(struct Board));
+    bool valid = true;
+    for (uint32_t i = 0; i < header->numNodes && valid; i++) {
+        const struct SessionNode *node = &nodes[i];
+        struct Board board;
+        int start = 0;
+        if (node->parent < 0) {
+            if (node->length == 0) {
+                valid = false;
+                break;
+            }
+            board = keyframes[node->firstKeyframe];
+            valid = boardIsValid(&board) && memcmp(&moves[node->firstPly], &noMove, sizeof(noMove)) == 0;
+            start = 1;
+        } else {
+            board = lastBoards[node->parent];
+        }
+        for (uint32_t ply = start; ply < node->length && valid; ply++) {
+            struct Move saved = moves[node->firstPly + ply];
+            struct Move move;
+            valid = findLegalMove(&board, saved.from, saved.to, saved.promotion, &move) &&
+                memcmp(&move, &saved, sizeof(move)) == 0;
+            if (valid) {
+                applyMove(&board, move);
+                valid = ply % header->keyframeInterval != 0 ||
+                    sameBoard(&board, &keyframes[node->firstKeyframe + ply / header->keyframeInterval]);
+            }
+        }
+        lastBoards[i] = board;
+    }
+    free(lastBoards);
+    return valid;
+}
+
+// Whether the file's tables are consistent, so building from them stays
+// inside the file and gives a tree, and its moves and boards are ones
+// movegen can be trusted with.
+static bool validSession(const struct MappedFile *file, const struct SessionHeader *header) {
+    struct SessionLayout layout;
+    if (file->size < sizeof(struct SessionHeader) ||
+        memcmp(header->magic, sessionMagic, sizeof(sessionMagic)) != 0 ||
+        header->version != SESSION_VERSION ||
+        header->boardSize != sizeof(struct Board) ||
+        header->keyframeInterval == 0 ||
+        header->numNodes == 0 ||
+        header->currentNode >= header->numNodes) {
+        return false;
+    }
+    sessionLayout(header, &layout);
+    if (layout.size != file->size) {
+        return false;
+    }
+    const struct SessionNode *nodes = (const struct SessionNode *)(file->data + layout.nodes);
+    for (uint32_t i = 0; i < header->numNodes; i++) {
+        const struct SessionNode *node = &nodes[i];
+        if ((i == 0) != (node->parent < 0) ||
+            node->parent >= (int32_t)i ||
+            node->length > header->numPlies - node->firstPly ||
+            node->firstPly > header->numPlies ||
+            numKeyframes(node->length, header->keyframeInterval) >
+                (int64_t)header->numKeyframes - node->firstKeyframe) {
+            return false;
+        }
+    }
+    const struct SessionNode *current = &nodes[header->currentNode];
+    if (header->currentTimestamp < 0 || (uint32_t)header->currentTimestamp >= current->length) {
+        return false;
+    }
+    return validMoves(file, header, &layout);
+}
+
+// Sets *root to the tree saved in filename, *current and
+// *currentTimestamp to the ply that was being looked at, and
+// *journalSequence to the last journal record it includes.
+int loadSession(
+    const char *filename, struct TimelineNode **root,
+    struct TimelineNode **current, int *currentTimestamp, uint32_t *journalSequence
+) {
+    struct MappedFile file;
+    CALL(mapFile(filename, &file));
+    const struct SessionHeader *header = (const struct SessionHeader *)file.data;
+    if (!validSession(&file, header)) {
+        unmapFile(&file);
+        set_error(1, "%s is not a session saved by this build", filename);
+        return 1;
+    }
+    struct SessionLayout layout;
+    sessionLayout(header, &layout);
+    const struct SessionNode *nodes = (const struct SessionNode *)(file.data + layout.nodes);
+    const struct Move *moves = (const struct Move *)(file.data + layout.moves);
+    const uint8_t *nags = (const uint8_t *)(file.data + layout.nags);
+    const struct Board *keyframes = (const struct Board *)(file.data + layout.keyframes);
+
+    struct TimelineNode **built = malloc(header->numNodes * sizeof(struct TimelineNode *));
+    for (uint32_t i = 0; i < header->numNodes; i++) {
+        const struct SessionNode *node = &nodes[i];
+        built[i] = addSavedTimeline(
+            node->parent < 0 ? NULL : built[node->parent],
+            moves + node->firstPly, nags + node->firstPly, node->length,
+            keyframes + node->firstKeyframe, header->keyframeInterval);
+    }
+    *root = built[0];
+    *current = built[header->currentNode];
+    *currentTimestamp = header->currentTimestamp;
+    *journalSequence = header->journalSequence;
+    LOG_INFO(LOG_TIMELINE, "Loaded %u plies in %u branches from %s",
+        header->numPlies, header->numNodes, filename);
+    free(built);
+    unmapFile(&file);
+    return 0;
+}
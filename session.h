@@ -0,0 +1,56 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include "timeline.h"
+#include "utarray.h"
+
+/*
+
+Saves the whole timeline tree, with the branch and ply being looked at,
+to a binary file, and loads it back.
+
+The file holds a table of branches in preorder, each pointing at its
+parent, then the moves and NAGs of every branch back to back, then a
+keyframe (a raw struct Board) for every SESSION_KEYFRAME_INTERVAL'th ply
+of each branch. Position hashes are not saved, only those keyframes:
+loading maps the file, builds the branches from the table and copies the
+moves in, and each run of plies gets its hashes replayed from its
+keyframe the first time it is looked at (see addSavedTimeline). Loading
+does replay every move once, on a board on the side, to refuse a file
+whose moves are not legal or whose keyframes are not where they lead,
+since movegen trusts what it is given. Interning hashes, the slow part of
+building a tree, is still left until plies are looked at.
+
+Keyframes are struct Boards as laid out by this build, and a file from a
+build whose struct Board differs is refused rather than misread.
+
+Saving is split in two so the slow part can run off the main thread:
+collectSession copies the tree into a struct SessionSnapshot, and
+writeSession writes that out. See journal.h for what calls them.
+
+*/
+
+#define SESSION_KEYFRAME_INTERVAL 64
+
+struct SessionSnapshot {
+    UT_array *nodes;     // the branch table
+    UT_array *moves;     // struct Move's
+    UT_array *nags;      // uint8_t's
+    UT_array *keyframes; // struct Board's
+    struct TimelineNode *current;
+    uint32_t currentNode;
+    int currentTimestamp;
+    uint32_t journalSequence;
+};
+
+void collectSession(
+    struct SessionSnapshot *snapshot, struct TimelineNode *root,
+    struct TimelineNode *current, int currentTimestamp, uint32_t journalSequence);
+int writeSession(const char *filename, const struct SessionSnapshot *snapshot);
+void freeSessionSnapshot(struct SessionSnapshot *snapshot);
+int loadSession(
+    const char *filename, struct TimelineNode **root,
+    struct TimelineNode **current, int *currentTimestamp, uint32_t *journalSequence);
+
+#endif
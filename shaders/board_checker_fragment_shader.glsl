@@ -0,0 +1,53 @@
+#version 330
+
+// Draws the board background without a texture, in place of board.png
+// and common_fragment_shader.glsl: an 8x8 checkerboard with a8 light and,
+// optionally, file letters in the bottom left of the last row's squares
+// and rank numbers in the top right of the last column's, like board.png.
+uniform vec4 lightColor;
+uniform vec4 darkColor;
+uniform bool showCoordinates;
+in vec2 fragTexCoord;
+out vec4 outputColor;
+
+// Glyph pixels across a square. Glyphs are 3x5 of them.
+const float GLYPH_GRID = 16.0;
+
+// a to h, then 1 to 8. Bit 3 * row + column is set for lit pixels, with
+// row 0 at the top and column 0 on the left.
+const int glyphs[16] = int[16](
+    0x7b98, 0x3b59, 0x6270, 0x6b74, 0x63d0, 0x25d4, 0x3d70, 0x5b59,
+    0x749a, 0x72a3, 0x38a3, 0x49ed, 0x38cf, 0x7bce, 0x24a7, 0x7bef
+);
+
+// Whether pixel, in glyph pixels from the glyph's top left, is lit.
+bool glyphLit(int glyph, vec2 pixel) {
+    if (pixel.x < 0.0 || pixel.y < 0.0 || pixel.x >= 3.0 || pixel.y >= 5.0) {
+        return false;
+    }
+    int bit = 3 * int(pixel.y) + int(pixel.x);
+    return ((glyphs[glyph] >> bit) & 1) != 0;
+}
+
+void main() {
+    vec2 board = fragTexCoord * 8.0;
+    ivec2 square = ivec2(min(floor(board), vec2(7.0)));
+    vec2 inSquare = (board - vec2(square)) * GLYPH_GRID;
+    // Glyphs smaller than a pixel would only be noise, as on thumbnails
+    bool glyphsVisible = fwidth(inSquare.x) <= 1.0;
+    bool light = (square.x + square.y) % 2 == 0;
+    outputColor = light ? lightColor : darkColor;
+    if (!showCoordinates || !glyphsVisible) {
+        return;
+    }
+    bool lit = false;
+    if (square.y == 7) {
+        lit = glyphLit(square.x, inSquare - vec2(1.0, GLYPH_GRID - 6.0));
+    }
+    if (square.x == 7) {
+        lit = lit || glyphLit(15 - square.y, inSquare - vec2(GLYPH_GRID - 4.0, 1.0));
+    }
+    if (lit) {
+        outputColor = light ? darkColor : lightColor;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330
+
+// Draws each board as two triangles straight from the vertex shader,
+// instead of a point expanded by board_geometry_shader.glsl. Drawn with 6
+// vertices per instance.
+in vec2 vertex;
+in float size;
+uniform mat4 perspective;
+
+out vec2 fragTexCoord;
+
+const vec2 corners[6] = vec2[6](
+    vec2(0, 0), vec2(1, 0), vec2(0, 1),
+    vec2(0, 1), vec2(1, 0), vec2(1, 1)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexID % 6];
+    gl_Position = perspective * vec4(vertex + corner * size, 0, 1.0);
+    fragTexCoord = corner;
+}
\ No newline at end of file
@@ -7,11 +7,11 @@ in VS_OUT {
     vec2 fragCoordTopLeft;
 } gs_in[];
 uniform mat4 perspective;
+uniform vec2 spriteSize; // of one piece in tex
 
 out vec2 fragTexCoord;
 
 void main() {
-    float pieceLength = 1.0 / 7.0;
     vec4 position = gl_in[0].gl_Position;
     float size = gs_in[0].size;
     
@@ -20,13 +20,12 @@ void main() {
     }
     
     vec2 fragCoordTopLeft = gs_in[0].fragCoordTopLeft;
-    //fragCoordTopLeft = vec2(2.0 / 7.0, 0.5);
     gl_Position = perspective * (position + vec4(0, size, 0, 0));
-    fragTexCoord = fragCoordTopLeft + vec2(0, 0.5);
+    fragTexCoord = fragCoordTopLeft + vec2(0, spriteSize.y);
     EmitVertex();
     
     gl_Position = perspective * (position + vec4(size, size, 0, 0));
-    fragTexCoord = fragCoordTopLeft + vec2(pieceLength, 0.5);
+    fragTexCoord = fragCoordTopLeft + spriteSize;
     EmitVertex();
     
     gl_Position = perspective * position;
@@ -34,7 +33,7 @@ void main() {
     EmitVertex();
     
     gl_Position = perspective * (position + vec4(size, 0, 0, 0));
-    fragTexCoord = fragCoordTopLeft + vec2(pieceLength, 0);
+    fragTexCoord = fragCoordTopLeft + vec2(spriteSize.x, 0);
     EmitVertex();
     
     EndPrimitive();
@@ -0,0 +1,46 @@
+#version 330
+
+// Draws the pieces of each board as two triangles per square straight
+// from the vertex shader, instead of points expanded by
+// piece_geometry_shader.glsl. Drawn with 6 vertices per square, 64
+// squares per instance. Squares without a piece come out as triangles
+// of no area, which are never rasterized.
+uniform int overrideID;
+uniform vec2 overridePosition;
+uniform mat4 perspective;
+uniform vec2 spriteSize; // of one piece in tex
+// Indexed by piece code: xy is the top left of its sprite in tex, z is 1
+// to draw it or 0 for no piece. Filled from pieceSprites in gl_chess.c.
+uniform vec3 pieceSprites[16];
+
+// One instance per board: where it goes and its squares, 4 bits each,
+// square n in bits 4 * (n % 8) of word n / 8 of squares0 then squares1.
+in vec2 boardTopLeft;
+in float boardSize;
+in uvec4 squares0;
+in uvec4 squares1;
+
+out vec2 fragTexCoord;
+
+const vec2 corners[6] = vec2[6](
+    vec2(0, 0), vec2(1, 0), vec2(0, 1),
+    vec2(0, 1), vec2(1, 0), vec2(1, 1)
+);
+
+void main() {
+    int boardPos = gl_VertexID / 6;
+    vec2 corner = corners[gl_VertexID % 6];
+    int word = boardPos / 8;
+    uint packed = word < 4 ? squares0[word] : squares1[word - 4];
+    int spriteType = int((packed >> uint(4 * (boardPos % 8))) & 15u);
+    vec2 topLeft;
+    if (boardPos == overrideID) {
+        topLeft = boardTopLeft + overridePosition;
+    } else {
+        topLeft = boardTopLeft + vec2(boardPos % 8, boardPos / 8) * boardSize / 8;
+    }
+    vec3 sprite = pieceSprites[spriteType];
+    float size = boardSize / 8 * sprite.z;
+    gl_Position = perspective * vec4(topLeft + corner * size, 0, 1.0);
+    fragTexCoord = sprite.xy + corner * spriteSize;
+}
\ No newline at end of file
@@ -1,10 +1,17 @@
 #version 330
 
-uniform float boardSize;
-uniform vec2 boardTopLeft;
 uniform int overrideID;
 uniform vec2 overridePosition;
-in int spriteType;
+// Indexed by piece code: xy is the top left of its sprite in tex, z is 1
+// to draw it or 0 for no piece. Filled from pieceSprites in gl_chess.c.
+uniform vec3 pieceSprites[16];
+
+// One instance per board: where it goes and its squares, 4 bits each,
+// square n in bits 4 * (n % 8) of word n / 8 of squares0 then squares1.
+in vec2 boardTopLeft;
+in float boardSize;
+in uvec4 squares0;
+in uvec4 squares1;
 
 out VS_OUT {
     float size;
@@ -13,6 +20,9 @@ out VS_OUT {
 
 void main() {
     int boardPos = gl_VertexID;
+    int word = boardPos / 8;
+    uint packed = word < 4 ? squares0[word] : squares1[word - 4];
+    int spriteType = int((packed >> uint(4 * (boardPos % 8))) & 15u);
     vec2 vertex;
     if (boardPos == overrideID) {
         vertex = boardTopLeft + overridePosition;        
@@ -25,65 +35,7 @@ void main() {
         );
     }
     gl_Position = vec4(vertex, 0.0, 1.0);
-    vs_out.size = boardSize / 8;
-    float texTop;
-    float texLeft;
-    float pieceWidth = 1.0 / 7.0;
-    
-    if (spriteType == 0) {
-        // WPawn
-        texTop = 0.5;
-        texLeft = 1.0 * pieceWidth;
-    } else if (spriteType == 1) {
-        // WKnight
-        texTop = 0.5;
-        texLeft = 2.0 * pieceWidth;
-    } else if (spriteType == 2) {
-        // WBiship
-        texTop = 0.5;
-        texLeft = 3.0 * pieceWidth;
-    } else if (spriteType == 3) {
-        // WRook
-        texTop = 0.5;
-        texLeft = 4.0 * pieceWidth;
-    } else if (spriteType == 4) {
-        // WKing
-        texTop = 0.5;
-        texLeft = 5.0 * pieceWidth;
-    } else if (spriteType == 5) {
-        // WQueen
-        texTop = 0.5;
-        texLeft = 6.0 * pieceWidth;
-    } else if (spriteType == 8) {
-        // BPawn
-        texTop = 0.0;
-        texLeft = 1.0 * pieceWidth;
-    } else if (spriteType == 9) {
-        // BKnight
-        texTop = 0.0;
-        texLeft = 2.0 * pieceWidth;
-    } else if (spriteType == 10) {
-        // BBiship
-        texTop = 0.0;
-        texLeft = 3.0 * pieceWidth;
-    } else if (spriteType == 11) {
-        // BRook
-        texTop = 0.0;
-        texLeft = 4.0 * pieceWidth;
-    } else if (spriteType == 12) {
-        // BKing
-        texTop = 0.0;
-        texLeft = 5.0 * pieceWidth;
-    } else if (spriteType == 13) {
-        // BQueen
-        texTop = 0.0;
-        texLeft = 6.0 * pieceWidth;
-    } else if (spriteType == 16) {
-        // Blank
-        vs_out.size = 0;
-    } else {
-        vs_out.size = 0;
-    }
-    
-    vs_out.fragCoordTopLeft = vec2(texLeft, texTop);
+    vec3 sprite = pieceSprites[spriteType];
+    vs_out.size = boardSize / 8 * sprite.z;
+    vs_out.fragCoordTopLeft = sprite.xy;
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 330
+
+layout (points) in;
+layout (triangle_strip, max_vertices=4) out;
+in VS_OUT {
+    float size;
+    vec2 texTopLeft;
+} gs_in[];
+uniform mat4 perspective;
+uniform float texSize; // width of a thumbnail in the atlas, in texture coordinates
+
+out vec2 fragTexCoord;
+
+void main() {
+    vec4 position = gl_in[0].gl_Position;
+    float size = gs_in[0].size;
+    vec2 texTopLeft = gs_in[0].texTopLeft;
+    gl_Position = perspective * (position + vec4(0, size, 0, 0));
+    fragTexCoord = texTopLeft + vec2(0, texSize);
+    EmitVertex();
+    
+    gl_Position = perspective * (position + vec4(size, size, 0, 0));
+    fragTexCoord = texTopLeft + vec2(texSize, texSize);
+    EmitVertex();
+    
+    gl_Position = perspective * position;
+    fragTexCoord = texTopLeft;
+    EmitVertex();
+    
+    gl_Position = perspective * (position + vec4(size, 0, 0, 0));
+    fragTexCoord = texTopLeft + vec2(texSize, 0);
+    EmitVertex();
+    
+    EndPrimitive();
+}
\ No newline at end of file
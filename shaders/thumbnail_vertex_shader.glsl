@@ -0,0 +1,17 @@
+#version 330
+
+// One instance per thumbnail
+in vec2 vertex;
+in float size;
+in vec2 texTopLeft;
+
+out VS_OUT {
+    float size;
+    vec2 texTopLeft;
+} vs_out;
+
+void main() {
+    gl_Position = vec4(vertex, 0, 1.0);
+    vs_out.size = size;
+    vs_out.texTopLeft = texTopLeft;
+}
\ No newline at end of file
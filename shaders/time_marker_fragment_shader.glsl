@@ -1,8 +1,9 @@
 #version 330
 
+uniform vec4 color;
 out vec4 outputColor;
 
 void main() {
-    // RED
-    outputColor = vec4(1.0, 0.0, 0.0, 1.0);
+    // Red for the time marker, blue for transposition marks
+    outputColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/glew.h>
+#include "errors.h"
+#include "log.h"
+#include "stream_buffer.h"
+
+#define PERSISTENT_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+void allocateStreamStorage(struct StreamBuffer *stream) {
+    glGenBuffers(1, &stream->bufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->bufferId);
+    if (stream->persistent) {
+        glBufferStorage(GL_ARRAY_BUFFER, stream->size, NULL, PERSISTENT_FLAGS);
+        stream->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, stream->size, PERSISTENT_FLAGS);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+        stream->mapped = NULL;
+    }
+    for (int i = 0; i < STREAM_BUFFER_REGIONS; i++) {
+        stream->fences[i] = NULL;
+    }
+    stream->region = 0;
+    stream->offset = 0;
+}
+
+int initStreamBuffer(struct StreamBuffer *stream, GLsizeiptr size) {
+    stream->size = size;
+    stream->persistent = GLEW_ARB_buffer_storage;
+    allocateStreamStorage(stream);
+    if (stream->persistent && stream->mapped == NULL) {
+        set_error(1, "Could not map the stream buffer");
+        return 1;
+    }
+    LOG_INFO(LOG_RENDER, "stream buffer: %ld bytes, %s",
+        (long)size, stream->persistent ? "persistent mapping" : "orphaning");
+    return 0;
+}
+
+void freeStreamBuffer(struct StreamBuffer *stream) {
+    for (int i = 0; i < STREAM_BUFFER_REGIONS; i++) {
+        if (stream->fences[i] != NULL) {
+            glClientWaitSync(stream->fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(stream->fences[i]);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, stream->bufferId);
+    if (stream->persistent) {
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glDeleteBuffers(1, &stream->bufferId);
+}
+
+// Replaces the buffer with one big enough for needed bytes per region.
+void growStreamBuffer(struct StreamBuffer *stream, GLsizeiptr needed) {
+    GLsizeiptr regions = stream->persistent ? STREAM_BUFFER_REGIONS : 1;
+    GLsizeiptr size = stream->size;
+    while (size / regions < needed) {
+        size *= 2;
+    }
+    LOG_INFO(LOG_RENDER, "stream buffer: growing to %ld bytes", (long)size);
+    freeStreamBuffer(stream);
+    stream->size = size;
+    allocateStreamStorage(stream);
+}
+
+void waitForRegion(struct StreamBuffer *stream, int region) {
+    GLsync fence = stream->fences[region];
+    if (fence == NULL) {
+        return;
+    }
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        LOG_DEBUG(LOG_RENDER, "stream buffer: waiting for the GPU");
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    }
+    glDeleteSync(fence);
+    stream->fences[region] = NULL;
+}
+
+// Copies size bytes of data into the ring at a multiple of alignment and
+// returns their offset in stream->bufferId.
+GLintptr streamUpload(struct StreamBuffer *stream, const void *data, GLsizeiptr size, GLsizeiptr alignment) {
+    GLintptr offset = (stream->offset + alignment - 1) / alignment * alignment;
+    if (stream->persistent) {
+        GLsizeiptr regionSize = stream->size / STREAM_BUFFER_REGIONS;
+        GLintptr regionEnd = (stream->region + 1) * regionSize;
+        if (offset + size > regionEnd) {
+            growStreamBuffer(stream, size + alignment);
+            offset = 0;
+        }
+        memcpy(stream->mapped + offset, data, size);
+    } else {
+        if (size > stream->size) {
+            growStreamBuffer(stream, size);
+            offset = 0;
+        } else if (offset + size > stream->size) {
+            // Orphan: draws still reading the old storage keep it
+            glBindBuffer(GL_ARRAY_BUFFER, stream->bufferId);
+            glBufferData(GL_ARRAY_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+            offset = 0;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, stream->bufferId);
+        void *mapped = glMapBufferRange(
+            GL_ARRAY_BUFFER, offset, size,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+        );
+        memcpy(mapped, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    stream->offset = offset + size;
+    return offset;
+}
+
+// Call once per frame after its last draw.
+void endStreamFrame(struct StreamBuffer *stream) {
+    if (!stream->persistent) {
+        return;
+    }
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_BUFFER_REGIONS;
+    waitForRegion(stream, stream->region);
+    stream->offset = stream->region * (stream->size / STREAM_BUFFER_REGIONS);
+}
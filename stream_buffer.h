@@ -0,0 +1,44 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <stdbool.h>
+#include <GL/glew.h>
+
+/*
+
+A ring buffer for geometry that changes every frame. Uploads are copied
+into the next free bytes of one GL buffer and draws read them from the
+returned offset, so nothing is reallocated per draw.
+
+With ARB_buffer_storage the buffer is mapped once, persistently, and split
+into STREAM_BUFFER_REGIONS regions, one per frame in flight. Each frame
+fills one region; endStreamFrame fences it, and the region is not written
+again until the GPU has passed that fence. Without it (e.g. macOS, which
+stops at GL 4.1) uploads go through unsynchronized glMapBufferRange, and
+the buffer is orphaned with glBufferData when it wraps, which lets the
+driver hand out fresh storage instead of stalling.
+
+An upload that does not fit grows the buffer, which may change bufferId.
+Point vertex attributes at bufferId at the returned offset for every draw.
+
+*/
+
+#define STREAM_BUFFER_REGIONS 3
+#define STREAM_BUFFER_INITIAL_SIZE (3 * 1024 * 1024)
+
+struct StreamBuffer {
+    GLuint bufferId;
+    GLsizeiptr size;   // bytes
+    GLintptr offset;   // next free byte
+    bool persistent;   // true when mapped with ARB_buffer_storage
+    char *mapped;      // the persistent mapping, NULL otherwise
+    GLsync fences[STREAM_BUFFER_REGIONS];
+    int region;        // region being filled, persistent only
+};
+
+int initStreamBuffer(struct StreamBuffer *stream, GLsizeiptr size);
+GLintptr streamUpload(struct StreamBuffer *stream, const void *data, GLsizeiptr size, GLsizeiptr alignment);
+void endStreamFrame(struct StreamBuffer *stream);
+void freeStreamBuffer(struct StreamBuffer *stream);
+
+#endif
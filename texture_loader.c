@@ -0,0 +1,191 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_THREAD_LOCAL _Thread_local // stbi_failure_reason per decode thread
+#include "stb_image.h"
+#include "errors.h"
+#include "log.h"
+#include "ktx.h"
+#include "texture_loader.h"
+
+GLenum textureFormat(int channels) {
+    switch (channels) {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        case 4: return GL_RGBA;
+        default: return GL_NONE;
+    }
+}
+
+GLenum textureInternalFormat(int channels) {
+    switch (channels) {
+        case 1: return GL_R8;
+        case 2: return GL_RG8;
+        case 3: return GL_RGB8;
+        case 4: return GL_RGBA8;
+        default: return GL_NONE;
+    }
+}
+
+// Whether the driver can sample what bake_textures.c writes.
+bool bakedTexturesSupported() {
+    return GLEW_EXT_texture_compression_s3tc;
+}
+
+void *decodeTexture(void *arg) {
+    struct TextureLoad *load = arg;
+    if (load->baked) {
+        // Reported when uploading, on the main thread
+        struct KtxImage ktx;
+        char error[KTX_ERROR_MAX_SIZE];
+        readKtx(load->imageFile, &ktx, error);
+        pthread_mutex_lock(&load->lock);
+        load->ktx = ktx;
+        memcpy(load->ktxError, error, sizeof(error));
+        load->decoded = true;
+        pthread_mutex_unlock(&load->lock);
+        if (load->wake != NULL) {
+            load->wake();
+        }
+        return NULL;
+    }
+    int width, height, channels;
+    unsigned char *pixels = stbi_load(load->imageFile, &width, &height, &channels, 0);
+    // This thread's, as STBI_THREAD_LOCAL keeps the other decode's apart
+    const char *failureReason = pixels == NULL ? stbi_failure_reason() : NULL;
+    pthread_mutex_lock(&load->lock);
+    load->pixels = pixels;
+    load->failureReason = failureReason;
+    load->width = width;
+    load->height = height;
+    load->channels = channels;
+    load->decoded = true;
+    pthread_mutex_unlock(&load->lock);
+    if (load->wake != NULL) {
+        load->wake();
+    }
+    return NULL;
+}
+
+// Creates the texture, filled with the placeholder RGBA texel, and starts
+// decoding imageFile into it. wake may be NULL.
+int startTextureLoad(
+    struct TextureLoad *load, char *imageFile,
+    const GLubyte placeholder[4], void (*wake)(void)
+) {
+    load->imageFile = imageFile;
+    load->wake = wake;
+    load->decoded = false;
+    load->uploaded = false;
+    load->pixels = NULL;
+    load->failureReason = NULL;
+    load->baked = isKtxFile(imageFile);
+    load->ktx.data = NULL;
+    glGenTextures(1, &load->textureId);
+    glBindTexture(GL_TEXTURE_2D, load->textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+    pthread_mutex_init(&load->lock, NULL);
+    if (pthread_create(&load->thread, NULL, decodeTexture, load) != 0) {
+        pthread_mutex_destroy(&load->lock);
+        set_error(1, "Could not start decoding %s", imageFile);
+        return 1;
+    }
+    return 0;
+}
+
+void uploadBakedTexture(struct TextureLoad *load) {
+    struct KtxImage *ktx = &load->ktx;
+    if (ktx->data == NULL) {
+        set_error(1, "%s", load->ktxError);
+        finalize_error();
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, load->textureId);
+    for (int level = 0; level < ktx->numLevels; level++) {
+        GLsizei width = ktx->width >> level;
+        GLsizei height = ktx->height >> level;
+        glCompressedTexImage2D(
+            GL_TEXTURE_2D, level, ktx->internalFormat,
+            width > 0 ? width : 1, height > 0 ? height : 1,
+            0, ktx->levelSizes[level], ktx->levels[level]);
+    }
+    // The levels may stop short of 1x1
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ktx->numLevels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    LOG_INFO(LOG_RENDER, "Loaded %s: %dx%d, %d compressed level(s)",
+        load->imageFile, ktx->width, ktx->height, ktx->numLevels);
+    freeKtx(ktx);
+}
+
+void uploadDecodedTexture(struct TextureLoad *load) {
+    pthread_join(load->thread, NULL);
+    pthread_mutex_destroy(&load->lock);
+    load->uploaded = true;
+    if (load->baked) {
+        uploadBakedTexture(load);
+        return;
+    }
+    if (load->pixels == NULL) {
+        set_error(1, "Could not decode %s: %s", load->imageFile, load->failureReason);
+        finalize_error();
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, load->textureId);
+    // Rows of 1 to 3 channel images need not start on 4 byte boundaries
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(
+        GL_TEXTURE_2D, 0,
+        textureInternalFormat(load->channels),
+        (GLsizei)load->width, (GLsizei)load->height,
+        0, textureFormat(load->channels),
+        GL_UNSIGNED_BYTE,
+        load->pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (load->channels <= 2) {
+        // Gray, or gray and alpha, sampled as RGBA
+        GLint swizzle[4] = {
+            GL_RED, GL_RED, GL_RED, load->channels == 2 ? GL_GREEN : GL_ONE
+        };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    stbi_image_free(load->pixels);
+    load->pixels = NULL;
+    LOG_INFO(LOG_RENDER, "Loaded %s: %dx%d, %d channel(s)",
+        load->imageFile, load->width, load->height, load->channels);
+}
+
+// Uploads the image if it has been decoded since the last call. Returns
+// whether the texture changed, in which case whatever was drawn with the
+// placeholder is out of date. Call on the thread that owns the context.
+bool updateTextureLoad(struct TextureLoad *load) {
+    if (load->uploaded) {
+        return false;
+    }
+    pthread_mutex_lock(&load->lock);
+    bool decoded = load->decoded;
+    pthread_mutex_unlock(&load->lock);
+    if (!decoded) {
+        return false;
+    }
+    uploadDecodedTexture(load);
+    return true;
+}
+
+// Waits for the image to be decoded and uploads it, if that has not
+// happened yet.
+void finishTextureLoad(struct TextureLoad *load) {
+    if (!load->uploaded) {
+        uploadDecodedTexture(load);
+    }
+}
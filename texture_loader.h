@@ -0,0 +1,52 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <GL/glew.h>
+#include "ktx.h"
+
+/*
+
+Loads image files into textures without holding up the first frame. Each
+file is decoded on a thread of its own while the window, shaders and
+buffers are set up, and the texture holds a 1x1 placeholder until then.
+GL is only touched on the thread that owns the context: the decoded
+pixels wait in the load until updateTextureLoad uploads them.
+
+The decoding thread calls wake when it is done, so a loop sleeping in
+glfwWaitEvents can pass glfwPostEmptyEvent to get back to uploading.
+
+A .ktx file (see bake_textures.c) is not decoded, only read, and its
+compressed mip levels are uploaded as they are and sampled trilinearly.
+Check bakedTexturesSupported before asking for one.
+
+*/
+
+struct TextureLoad {
+    char *imageFile;
+    GLuint textureId;                  // valid from startTextureLoad on
+    pthread_t thread;
+    void (*wake)(void);
+    pthread_mutex_t lock;
+    bool decoded;                      // guarded by lock
+    bool uploaded;
+    unsigned char *pixels;             // NULL if the file could not be decoded
+    const char *failureReason;         // why, from stb_image
+    bool baked;                        // imageFile is a .ktx file, read into ktx
+    struct KtxImage ktx;               // ktx.data is NULL if it could not be read
+    char ktxError[KTX_ERROR_MAX_SIZE]; // why it could not
+    int width;
+    int height;
+    int channels;
+};
+
+GLenum textureFormat(int channels);
+bool bakedTexturesSupported();
+int startTextureLoad(
+    struct TextureLoad *load, char *imageFile,
+    const GLubyte placeholder[4], void (*wake)(void));
+bool updateTextureLoad(struct TextureLoad *load);
+void finishTextureLoad(struct TextureLoad *load);
+
+#endif
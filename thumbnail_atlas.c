@@ -0,0 +1,140 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <GL/glew.h>
+#include "errors.h"
+#include "thumbnail_atlas.h"
+
+int initThumbnailAtlas(struct ThumbnailAtlas *atlas) {
+    glGenTextures(1, &atlas->textureId);
+    glBindTexture(GL_TEXTURE_2D, atlas->textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL
+    );
+
+    glGenFramebuffers(1, &atlas->framebufferId);
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas->framebufferId);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas->textureId, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status == GL_FRAMEBUFFER_COMPLETE) {
+        GLfloat clearColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        set_error(1, "Thumbnail atlas framebuffer is incomplete (0x%x)", status);
+        return 1;
+    }
+
+    for (int i = 0; i < ATLAS_NUM_BUCKETS; i++) {
+        atlas->buckets[i] = -1;
+    }
+    // Every slot starts out empty, in one LRU list from 0 (newest) to the
+    // last slot (oldest)
+    for (int i = 0; i < ATLAS_NUM_SLOTS; i++) {
+        struct AtlasSlot *slot = &atlas->slots[i];
+        slot->filled = false;
+        slot->lastUsedFrame = 0;
+        slot->newer = i - 1;
+        slot->older = i + 1 < ATLAS_NUM_SLOTS ? i + 1 : -1;
+        slot->nextInBucket = -1;
+    }
+    atlas->newest = 0;
+    atlas->oldest = ATLAS_NUM_SLOTS - 1;
+    atlas->frame = 1;
+    return 0;
+}
+
+void beginAtlasFrame(struct ThumbnailAtlas *atlas) {
+    atlas->frame++;
+}
+
+// Forgets every thumbnail, for when what they were drawn from changed.
+void clearThumbnailAtlas(struct ThumbnailAtlas *atlas) {
+    for (int i = 0; i < ATLAS_NUM_BUCKETS; i++) {
+        atlas->buckets[i] = -1;
+    }
+    for (int i = 0; i < ATLAS_NUM_SLOTS; i++) {
+        atlas->slots[i].filled = false;
+    }
+}
+
+void unlinkLru(struct ThumbnailAtlas *atlas, int index) {
+    struct AtlasSlot *slot = &atlas->slots[index];
+    if (slot->newer != -1) {
+        atlas->slots[slot->newer].older = slot->older;
+    } else {
+        atlas->newest = slot->older;
+    }
+    if (slot->older != -1) {
+        atlas->slots[slot->older].newer = slot->newer;
+    } else {
+        atlas->oldest = slot->newer;
+    }
+}
+
+void makeNewest(struct ThumbnailAtlas *atlas, int index) {
+    if (atlas->newest == index) {
+        return;
+    }
+    unlinkLru(atlas, index);
+    struct AtlasSlot *slot = &atlas->slots[index];
+    slot->newer = -1;
+    slot->older = atlas->newest;
+    atlas->slots[atlas->newest].newer = index;
+    atlas->newest = index;
+}
+
+void removeFromBucket(struct ThumbnailAtlas *atlas, int index) {
+    int *link = &atlas->buckets[atlas->slots[index].key % ATLAS_NUM_BUCKETS];
+    while (*link != index) {
+        link = &atlas->slots[*link].nextInBucket;
+    }
+    *link = atlas->slots[index].nextInBucket;
+}
+
+// Returns the slot holding the thumbnail for key, setting *fresh if it was
+// just claimed and still has to be drawn, or -1 if every slot is already
+// in use this frame.
+int atlasSlotFor(struct ThumbnailAtlas *atlas, uint64_t key, bool *fresh) {
+    int bucket = key % ATLAS_NUM_BUCKETS;
+    for (int i = atlas->buckets[bucket]; i != -1; i = atlas->slots[i].nextInBucket) {
+        if (atlas->slots[i].key == key) {
+            atlas->slots[i].lastUsedFrame = atlas->frame;
+            makeNewest(atlas, i);
+            *fresh = false;
+            return i;
+        }
+    }
+
+    int index = atlas->oldest;
+    struct AtlasSlot *slot = &atlas->slots[index];
+    if (slot->lastUsedFrame == atlas->frame) {
+        return -1;
+    }
+    if (slot->filled) {
+        removeFromBucket(atlas, index);
+    }
+    slot->key = key;
+    slot->filled = true;
+    slot->lastUsedFrame = atlas->frame;
+    slot->nextInBucket = atlas->buckets[bucket];
+    atlas->buckets[bucket] = index;
+    makeNewest(atlas, index);
+    *fresh = true;
+    return index;
+}
+
+// Pixel position of the slot's top left in the atlas, with y going down
+// as it does in window coordinates.
+void atlasSlotTopLeft(int slot, GLfloat *x, GLfloat *y) {
+    *x = (slot % ATLAS_SLOTS_PER_ROW) * ATLAS_SLOT_SIZE;
+    *y = (slot / ATLAS_SLOTS_PER_ROW) * ATLAS_SLOT_SIZE;
+}
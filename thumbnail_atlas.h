@@ -0,0 +1,54 @@
+#ifndef THUMBNAIL_ATLAS_H
+#define THUMBNAIL_ATLAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+/*
+
+Timeline thumbnails are drawn once into slots of one framebuffer backed
+texture and from then on drawn as textured quads. Slots are keyed by the
+position's Zobrist hash, so transpositions share one, and the least
+recently used slot is given to the next new thumbnail. Slots used in the
+current frame are never taken; when all of them are, atlasSlotFor returns
+-1 and the caller draws that thumbnail directly.
+
+Each slot keeps a ATLAS_SLOT_PADDING pixel border around the board so that
+linear filtering never reads a neighbour.
+
+*/
+
+#define ATLAS_SIZE 2048
+#define ATLAS_SLOT_SIZE 128
+#define ATLAS_SLOT_PADDING 1
+#define ATLAS_SLOTS_PER_ROW (ATLAS_SIZE / ATLAS_SLOT_SIZE)
+#define ATLAS_NUM_SLOTS (ATLAS_SLOTS_PER_ROW * ATLAS_SLOTS_PER_ROW)
+#define ATLAS_NUM_BUCKETS 512
+
+struct AtlasSlot {
+    uint64_t key;
+    bool filled;
+    unsigned lastUsedFrame;
+    int newer;        // LRU list neighbours, -1 at the ends
+    int older;
+    int nextInBucket; // next slot in the same hash bucket, or -1
+};
+
+struct ThumbnailAtlas {
+    GLuint framebufferId;
+    GLuint textureId;
+    struct AtlasSlot slots[ATLAS_NUM_SLOTS];
+    int buckets[ATLAS_NUM_BUCKETS]; // first slot of each bucket, or -1
+    int newest;
+    int oldest;
+    unsigned frame;
+};
+
+int initThumbnailAtlas(struct ThumbnailAtlas *atlas);
+void beginAtlasFrame(struct ThumbnailAtlas *atlas);
+void clearThumbnailAtlas(struct ThumbnailAtlas *atlas);
+int atlasSlotFor(struct ThumbnailAtlas *atlas, uint64_t key, bool *fresh);
+void atlasSlotTopLeft(int slot, GLfloat *x, GLfloat *y);
+
+#endif
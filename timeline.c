@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include "timeline.h"
+
+UT_icd ply_icd = { sizeof(struct Ply), NULL, NULL, NULL };
+UT_icd board_icd = { sizeof(struct Board), NULL, NULL, NULL };
+
+struct TimelineSegment *newSegment() {
+    struct TimelineSegment *segment = malloc(sizeof(struct TimelineSegment));
+    segment->refCount = 1;
+    utarray_new(segment->plies, &ply_icd);
+    utarray_new(segment->keyframes, &board_icd);
+    segment->keyframeInterval = KEYFRAME_INTERVAL;
+    return segment;
+}
+
+void releaseSegment(struct TimelineSegment *segment) {
+    segment->refCount--;
+    if (segment->refCount == 0) {
+        int numPlies = utarray_len(segment->plies);
+        for (int i = 0; i < numPlies; i++) {
+            struct Ply *ply = utarray_eltptr(segment->plies, i);
+            if (ply->interned) {
+                releasePosition(ply->hash);
+            }
+        }
+        utarray_free(segment->plies);
+        utarray_free(segment->keyframes);
+        free(segment);
+    }
+}
+
+struct TimelineNode *newTimeline(struct TimelineNode *parent) {
+    struct TimelineNode *tl = malloc(sizeof(struct TimelineNode));
+    tl->parent = parent;
+    tl->segment = newSegment();
+    tl->offset = 0;
+    tl->length = 0;
+    utarray_new(tl->children, &ut_ptr_icd);
+    tl->rowOffset = 0;
+    tl->subtreeLength = 0;
+    tl->subtreeHeight = 1;
+    return tl;
+}
+
+// Recomputes the cached subtree sizes of timeline and its ancestors after
+// timeline or one of its children changed size, stopping at the first
+// ancestor whose sizes come out the same. A subtree that got taller pushes
+// the siblings after it down so their rows don't overlap; their branches
+// keep their rows relative to them, so nothing further down is touched.
+void updateSubtreeSizes(struct TimelineNode *timeline) {
+    for (struct TimelineNode *node = timeline; node != NULL; node = node->parent) {
+        int numChildren = utarray_len(node->children);
+        int maxChildLength = 0;
+        int sumChildHeight = 0;
+        for (int i = 0; i < numChildren; i++) {
+            struct TimelineNode *child = timelineChild(node, i);
+            if (child->subtreeLength > maxChildLength) {
+                maxChildLength = child->subtreeLength;
+            }
+            sumChildHeight += child->subtreeHeight;
+        }
+        int subtreeLength = node->length + maxChildLength;
+        int subtreeHeight = numChildren > 0 ? sumChildHeight : 1;
+        if (node != timeline &&
+            subtreeLength == node->subtreeLength &&
+            subtreeHeight == node->subtreeHeight) {
+            break;
+        }
+        int addedRows = subtreeHeight - node->subtreeHeight;
+        node->subtreeLength = subtreeLength;
+        node->subtreeHeight = subtreeHeight;
+        if (addedRows != 0 && node->parent != NULL) {
+            int numSiblings = utarray_len(node->parent->children);
+            for (int i = timelineChildIndex(node->parent, node) + 1; i < numSiblings; i++) {
+                timelineChild(node->parent, i)->rowOffset += addedRows;
+            }
+        }
+    }
+}
+
+// The ply timeline starts at, counting from the start of the root.
+int timelineStartPly(struct TimelineNode *timeline) {
+    int startPly = 0;
+    for (struct TimelineNode *node = timeline->parent; node != NULL; node = node->parent) {
+        startPly += node->length;
+    }
+    return startPly;
+}
+
+// The row timeline is drawn in, counting down from the root's.
+int timelineRow(struct TimelineNode *timeline) {
+    int row = 0;
+    for (struct TimelineNode *node = timeline; node != NULL; node = node->parent) {
+        row += node->rowOffset;
+    }
+    return row;
+}
+
+// Frees timeline and all of its branches.
+void freeTimeline(struct TimelineNode *timeline) {
+    int numChildren = utarray_len(timeline->children);
+    for (int i = 0; i < numChildren; i++) {
+        freeTimeline(timelineChild(timeline, i));
+    }
+    utarray_free(timeline->children);
+    releaseSegment(timeline->segment);
+    free(timeline);
+}
+
+struct TimelineNode *timelineChild(struct TimelineNode *timeline, int index) {
+    return *(struct TimelineNode **)utarray_eltptr(timeline->children, index);
+}
+
+int timelineChildIndex(struct TimelineNode *timeline, struct TimelineNode *child) {
+    int numChildren = utarray_len(timeline->children);
+    for (int i = 0; i < numChildren; i++) {
+        if (timelineChild(timeline, i) == child) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+struct TimelineNode *addChildTimeline(struct TimelineNode *timeline) {
+    struct TimelineNode *child = newTimeline(timeline);
+    // Below the rows the branches already there take up
+    child->rowOffset = utarray_len(timeline->children) > 0 ? timeline->subtreeHeight : 0;
+    utarray_push_back(timeline->children, &child);
+    updateSubtreeSizes(timeline);
+    return child;
+}
+
+// Adds a branch of length saved plies under parent, or a new root if
+// parent is NULL, without looking up their hashes. keyframes holds the
+// board at ply 0, keyframeInterval, 2 * keyframeInterval and so on.
+struct TimelineNode *addSavedTimeline(
+    struct TimelineNode *parent, const struct Move *moves, const uint8_t *nags, int length,
+    const struct Board *keyframes, int keyframeInterval
+) {
+    struct TimelineNode *timeline = parent != NULL ? addChildTimeline(parent) : newTimeline(NULL);
+    struct TimelineSegment *segment = timeline->segment;
+    utarray_resize(segment->plies, length);
+    for (int i = 0; i < length; i++) {
+        struct Ply *ply = utarray_eltptr(segment->plies, i);
+        ply->move = moves[i];
+        ply->nag = nags[i];
+        ply->interned = false;
+    }
+    int numKeyframes = (length + keyframeInterval - 1) / keyframeInterval;
+    for (int i = 0; i < numKeyframes; i++) {
+        utarray_push_back(segment->keyframes, &keyframes[i]);
+    }
+    segment->keyframeInterval = keyframeInterval;
+    timeline->length = length;
+    updateSubtreeSizes(timeline);
+    return timeline;
+}
+
+// The board at ply index of segment's keyframe before it.
+struct Board *segmentKeyframe(struct TimelineSegment *segment, int index) {
+    return utarray_eltptr(segment->keyframes, index / segment->keyframeInterval);
+}
+
+// Interns the hashes of the run of plies from the keyframe before index to
+// the next one, replaying their moves from that keyframe.
+void fillSavedPositions(struct TimelineSegment *segment, int index) {
+    int numPlies = utarray_len(segment->plies);
+    int interval = segment->keyframeInterval;
+    int start = index / interval * interval;
+    int end = start + interval < numPlies ? start + interval : numPlies;
+    struct Board board = *segmentKeyframe(segment, start);
+    for (int i = start; i < end; i++) {
+        struct Ply *ply = utarray_eltptr(segment->plies, i);
+        if (i > start) {
+            applyMove(&board, ply->move);
+        }
+        if (!ply->interned) {
+            ply->hash = board.hash;
+            ply->interned = true;
+            internPosition(ply->hash);
+        }
+    }
+}
+
+// A ply as it is stored, which may not have its hash yet.
+struct Ply *storedPly(struct TimelineNode *timeline, int index) {
+    return utarray_eltptr(timeline->segment->plies, timeline->offset + index);
+}
+
+struct Ply *timelinePly(struct TimelineNode *timeline, int index) {
+    struct Ply *ply = storedPly(timeline, index);
+    if (!ply->interned) {
+        fillSavedPositions(timeline->segment, timeline->offset + index);
+    }
+    return ply;
+}
+
+struct Move timelineMove(struct TimelineNode *timeline, int index) {
+    return storedPly(timeline, index)->move;
+}
+
+int timelineNag(struct TimelineNode *timeline, int index) {
+    return storedPly(timeline, index)->nag;
+}
+
+void setTimelineNag(struct TimelineNode *timeline, int index, int nag) {
+    storedPly(timeline, index)->nag = nag;
+}
+
+// Whether the position at ply index is also reached elsewhere, by another
+// branch or earlier in the same one.
+bool isTransposition(struct TimelineNode *timeline, int index) {
+    return positionRefCount(timelinePly(timeline, index)->hash) > 1;
+}
+
+// Replays the board at ply index from the keyframe before it, at most
+// keyframeInterval - 1 moves.
+void getTimelineBoard(struct TimelineNode *timeline, int index, struct Board *board) {
+    timelinePly(timeline, index);
+    peekTimelineBoard(timeline, index, board);
+}
+
+// Like getTimelineBoard, but a saved ply that has no hash yet is not
+// interned, so nothing outside the board changes.
+void peekTimelineBoard(struct TimelineNode *timeline, int index, struct Board *board) {
+    struct TimelineSegment *segment = timeline->segment;
+    int savedIndex = timeline->offset + index;
+    int start = savedIndex / segment->keyframeInterval * segment->keyframeInterval;
+    *board = *segmentKeyframe(segment, start);
+    for (int i = start + 1; i <= savedIndex; i++) {
+        applyMove(board, ((struct Ply *)utarray_eltptr(segment->plies, i))->move);
+    }
+}
+
+// Gives timeline a segment of its own holding just its plies, with
+// keyframes replayed to match their new offsets. No other view covers the
+// plies, so their position references move over rather than being copied.
+void detachSegment(struct TimelineNode *timeline) {
+    struct TimelineSegment *segment = newSegment();
+    struct Board board;
+    peekTimelineBoard(timeline, 0, &board);
+    for (int i = 0; i < timeline->length; i++) {
+        struct Ply *ply = storedPly(timeline, i);
+        if (i > 0) {
+            applyMove(&board, ply->move);
+        }
+        if (i % segment->keyframeInterval == 0) {
+            utarray_push_back(segment->keyframes, &board);
+        }
+        utarray_push_back(segment->plies, ply);
+        ply->interned = false;
+    }
+    releaseSegment(timeline->segment);
+    timeline->segment = segment;
+    timeline->offset = 0;
+}
+
+// Appends a ply to the end of timeline. board is the position after move.
+void pushPly(struct TimelineNode *timeline, struct Board *board, struct Move move) {
+    if (timeline->offset + timeline->length != utarray_len(timeline->segment->plies)) {
+        // Copy on write: the plies after ours belong to another branch
+        detachSegment(timeline);
+    }
+    struct TimelineSegment *segment = timeline->segment;
+    if (utarray_len(segment->plies) % segment->keyframeInterval == 0) {
+        utarray_push_back(segment->keyframes, board);
+    }
+    struct Ply ply;
+    ply.hash = board->hash;
+    ply.move = move;
+    ply.nag = 0;
+    ply.interned = true;
+    internPosition(ply.hash);
+    utarray_push_back(segment->plies, &ply);
+    // Branches under timeline, if any, now start one ply later without
+    // being touched, as they start where timeline ends
+    timeline->length++;
+    updateSubtreeSizes(timeline);
+}
+
+// Splits timeline after ply index without copying any plies. A new node
+// holding plies 0 to index takes timeline's place in the tree, and
+// timeline, keeping the later plies and its branches, becomes its only
+// child. Returns the new node.
+struct TimelineNode *splitTimeline(struct TimelineNode *timeline, int index) {
+    struct TimelineNode *head = malloc(sizeof(struct TimelineNode));
+    head->parent = timeline->parent;
+    head->segment = timeline->segment;
+    head->segment->refCount++;
+    head->offset = timeline->offset;
+    head->length = index + 1;
+    utarray_new(head->children, &ut_ptr_icd);
+    utarray_push_back(head->children, &timeline);
+    // The plies stay where they were on screen, so no other node moves
+    head->rowOffset = timeline->rowOffset;
+    head->subtreeLength = timeline->subtreeLength;
+    head->subtreeHeight = timeline->subtreeHeight;
+
+    if (timeline->parent != NULL) {
+        int childIndex = timelineChildIndex(timeline->parent, timeline);
+        *(struct TimelineNode **)utarray_eltptr(timeline->parent->children, childIndex) = head;
+    }
+    timeline->parent = head;
+    timeline->offset += index + 1;
+    timeline->length -= index + 1;
+    timeline->rowOffset = 0;
+    timeline->subtreeLength -= index + 1;
+    return head;
+}
+
+// Adds the ply for move, which led to board, after ply index of timeline:
+// at its end if nothing follows that ply yet, otherwise on a new branch.
+// If plies follow index on timeline itself, timeline is split after index
+// first, and *head (if not NULL) is set to the node that took plies 0 to
+// index, else to NULL. *root follows the root if it is split. Returns the
+// branch holding the new ply, as its last.
+struct TimelineNode *addPly(
+    struct TimelineNode **root, struct TimelineNode *timeline, int index,
+    struct Board *board, struct Move move, struct TimelineNode **head
+) {
+    if (head != NULL) {
+        *head = NULL;
+    }
+    int numChildren = utarray_len(timeline->children);
+    if (timeline->length == 0 || (index == timeline->length - 1 && numChildren == 0)) {
+        pushPly(timeline, board, move);
+        return timeline;
+    }
+    if (index < timeline->length - 1) {
+        // The rest of this timeline, and the branches off it, become a
+        // child so that every branch still follows its moves
+        struct TimelineNode *split = splitTimeline(timeline, index);
+        if (timeline == *root) {
+            *root = split;
+        }
+        if (head != NULL) {
+            *head = split;
+        }
+        timeline = split;
+    }
+    struct TimelineNode *child = addChildTimeline(timeline);
+    pushPly(child, board, move);
+    return child;
+}
@@ -0,0 +1,85 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdbool.h>
+#include "board.h"
+#include "movegen.h"
+#include "positions.h"
+#include "utarray.h"
+
+#define KEYFRAME_INTERVAL 64 // plies between full board copies in a segment
+
+/*
+
+A timeline is a tree of branches. Each branch (struct TimelineNode) is a
+view of plies [offset, offset + length) of a segment. Splitting a branch
+makes two views of the same segment instead of copying plies, so segments
+are reference counted. Views of one segment never overlap. Ply 0 of a
+child follows the last ply of its parent.
+
+A ply keeps only its move and the hash of the position it reaches, which
+is counted in positions.h so branches that transpose into each other can
+be found. Boards are not stored per ply: each segment keeps the board at
+every keyframeInterval'th ply, and any other ply's board is replayed from
+the keyframe before it. Plies of a loaded session get their hashes the
+first time they are looked up, so a transposition into a part of the tree
+not looked at yet is not seen until it is.
+
+Every node also keeps the size of its subtree, updated along the path to
+the root as the tree changes, and its place in the layout relative to its
+parent, so an edit never has to move the branches under it. A branch
+starts where its parent ends. The first child carries on its parent's row
+and each later child is drawn below all the rows its earlier siblings'
+subtrees take up (subtreeHeight). Walks of the tree add these up on the
+way down; timelineStartPly and timelineRow add them up for one node.
+
+*/
+
+struct Ply {
+    uint64_t hash;            // Zobrist hash of the position move reached
+    struct Move move;
+    uint8_t nag;              // PGN annotation glyph of move ($1 is !), 0 for none
+    bool interned;            // hash is set and counted in positions.c
+};
+
+struct TimelineSegment {
+    int refCount;
+    UT_array *plies;         // array of struct Ply's
+    UT_array *keyframes;     // struct Board's, the board at every keyframeInterval'th ply
+    int keyframeInterval;    // KEYFRAME_INTERVAL, or what a loaded session used
+};
+
+struct TimelineNode {
+    struct TimelineNode *parent;
+    struct TimelineSegment *segment;
+    int offset;
+    int length;
+    UT_array *children; // array of struct TimelineNode *'s
+    int rowOffset;      // rows below its parent's row
+    int subtreeLength;  // plies on the longest path from the start of this branch
+    int subtreeHeight;  // rows this branch and those under it take up
+};
+
+struct TimelineNode *newTimeline(struct TimelineNode *parent);
+void freeTimeline(struct TimelineNode *timeline);
+struct TimelineNode *timelineChild(struct TimelineNode *timeline, int index);
+int timelineChildIndex(struct TimelineNode *timeline, struct TimelineNode *child);
+int timelineStartPly(struct TimelineNode *timeline);
+int timelineRow(struct TimelineNode *timeline);
+struct TimelineNode *addChildTimeline(struct TimelineNode *timeline);
+struct TimelineNode *addSavedTimeline(
+    struct TimelineNode *parent, const struct Move *moves, const uint8_t *nags, int length,
+    const struct Board *keyframes, int keyframeInterval);
+struct Move timelineMove(struct TimelineNode *timeline, int index);
+int timelineNag(struct TimelineNode *timeline, int index);
+void setTimelineNag(struct TimelineNode *timeline, int index, int nag);
+bool isTransposition(struct TimelineNode *timeline, int index);
+void getTimelineBoard(struct TimelineNode *timeline, int index, struct Board *board);
+void peekTimelineBoard(struct TimelineNode *timeline, int index, struct Board *board);
+void pushPly(struct TimelineNode *timeline, struct Board *board, struct Move move);
+struct TimelineNode *splitTimeline(struct TimelineNode *timeline, int index);
+struct TimelineNode *addPly(
+    struct TimelineNode **root, struct TimelineNode *timeline, int index,
+    struct Board *board, struct Move move, struct TimelineNode **head);
+
+#endif
@@ -0,0 +1,319 @@
+#include <stdint.h>
+#include "zobrist.h"
+
+/*
+
+Random keys for Zobrist hashing. They were produced once with splitmix64
+seeded with 0x5EED5EED5EED5EED and are fixed so that hashes stay the same
+between runs and can be saved.
+
+*/
+
+// Indexed by [enum Piece][square]. Rows 6, 7, 14 and 15 are not pieces.
+const uint64_t zobristPieceKeys[16][64] = {
+    {
+        0xfbfd33b4b6e4d3f7ULL, 0xe32b9bc4598b0c68ULL, 0x272a85352b21bfcfULL, 0xac591be38eacdfe9ULL,
+        0xa2aad7f99ef86ee7ULL, 0x09e2f0ccc942092dULL, 0x9027ae202ac1bc2eULL, 0x4c54f5d4f16d29e5ULL,
+        0x81158102e8218acaULL, 0x09b273e7a1fb9e9bULL, 0xf435ad3a80eedeb9ULL, 0x278c279483f12332ULL,
+        0x451064feda1a4f21ULL, 0x665567138caeb6e3ULL, 0xf6636950b7117403ULL, 0x144651fa83820246ULL,
+        0x372ed99018c37e0aULL, 0xd2e68d7c6d8ceba4ULL, 0x61363f5af069ff39ULL, 0x813b741eec48b80aULL,
+        0xa61aa4a8cde732b6ULL, 0x99e1a50cd567365fULL, 0x8609619f5a71013eULL, 0x8e42d6c9fadac95dULL,
+        0xaf217dc34650cf44ULL, 0x68e816c687bb74b1ULL, 0x2785902fb927d651ULL, 0x4dca11d52d56b562ULL,
+        0x045e9bae2b6a0facULL, 0x588c0bd814245422ULL, 0x0522c32508c89e61ULL, 0x11fec785f1ec0b28ULL,
+        0x63f512e43a92fc12ULL, 0x202d0b3c7b6707f9ULL, 0x094a74149d4910ceULL, 0xc05a908d4c4d6073ULL,
+        0xb87eb6cb32df03bdULL, 0x89def6bb383bb967ULL, 0x0390d561ca352a0bULL, 0x7ae42ea6bd0c474dULL,
+        0x516c05b346da7948ULL, 0xebafca2fed52338eULL, 0x012f56542e0809a5ULL, 0xe82348edce0cab22ULL,
+        0x319357a0dff464ffULL, 0xa8a35a6f65a85c90ULL, 0x343ef0611320fe3cULL, 0x14abbf88b693a65aULL,
+        0x169a314427bb40dcULL, 0x6d7022d5b3eefef0ULL, 0xbbd45d568363cef1ULL, 0xce40f02a54f84313ULL,
+        0x569d302b08e84847ULL, 0x3bb089d5d6ca9518ULL, 0x92da902abb10377cULL, 0x73efb6f29069fdd2ULL,
+        0xae8e4fa8f067a9e9ULL, 0xadaa406e0382f2c1ULL, 0x8ba41c716244af84ULL, 0xf9fd6af54b1b7f8dULL,
+        0xc9b4115ed1366c8fULL, 0x25256ed6cf120e22ULL, 0x26a4b4c07c1297aaULL, 0x4e34e9d59dfacadfULL,
+    },
+    {
+        0x14433ccaf07ce5cdULL, 0x081f5cf6a82f634dULL, 0xc136d7e687f7f31fULL, 0x13fdb75aa5b72d19ULL,
+        0xc78bc9e14ae49b3fULL, 0xfd0943999fa15c7eULL, 0x8db2cf18f09eb253ULL, 0x5f8492c2e02f6b21ULL,
+        0x377b6605d09f8842ULL, 0x52c20dfee141187cULL, 0x3f6266be22ea796dULL, 0xc16d923a878e7603ULL,
+        0x1083eefb600c07d4ULL, 0x765ce2da1577f16cULL, 0x8901ba3516bf423dULL, 0x672569b989a117afULL,
+        0x682127cd87fa7f44ULL, 0x3e0d5df983f28015ULL, 0xcf14e97e83f7e2a4ULL, 0x706f98e695a0a52dULL,
+        0x2bb9ad96a24acba8ULL, 0x923c4382370372b9ULL, 0x250e78f2f4930df1ULL, 0x03489867b9c8d388ULL,
+        0x91fbeded1f447a55ULL, 0x2aad84589927ed32ULL, 0xe302197d2d5b02f3ULL, 0x1eca97df284715f6ULL,
+        0xf769398bfebed3ffULL, 0x31f88f562d0b938aULL, 0x9055780266e17ae5ULL, 0x00063f8f8b7e8b86ULL,
+        0x9b09cceff8029d37ULL, 0xeb80a6751423fe85ULL, 0xc016c03c64484ec2ULL, 0xafc4defc35e29fa4ULL,
+        0x6abcf4121e12ad94ULL, 0x461ca9ea3cbf5a66ULL, 0x94b667213714dd9dULL, 0x8b0d2334605b0483ULL,
+        0x8b8bde12101f073dULL, 0xd638b4ed6858ea5eULL, 0x1ca4fc7f761f8112ULL, 0xa624c1e3e9a78a2fULL,
+        0x0841e3df49ca2754ULL, 0xd3e50e63b5c59963ULL, 0x4eadb26b1811d1dbULL, 0xcd32b6bbd545636eULL,
+        0xa72f2bacda68c6a2ULL, 0x36173d53b4ca9becULL, 0x8525e3bcc3f3a133ULL, 0x9f2e2b139c524003ULL,
+        0x8c99f807349b9bd1ULL, 0x4e2f708c8554d42fULL, 0xda7895ee2b757db7ULL, 0xd852deb89b1fc748ULL,
+        0xad7bd0c6fa4aca68ULL, 0x6e0e73e3287a0de9ULL, 0x284d9dd06d367319ULL, 0xba836163a2f00f6cULL,
+        0x8d621ac99656c3daULL, 0x3ff5271b440bec2cULL, 0x861f8adaf0f8dea2ULL, 0x27961e1a92865217ULL,
+    },
+    {
+        0xf102e2ece4b62879ULL, 0xaa66885254752a64ULL, 0x7d97e03c69467585ULL, 0x8a6e6521dc3820aaULL,
+        0xa3dcd8e482661d97ULL, 0x0883b8b94b826bacULL, 0x06dc81d65033cfcfULL, 0xcdcca7513808e46fULL,
+        0x194b5a2900dbc39bULL, 0xa10eccf7527bcd50ULL, 0xa02f449df86aaacdULL, 0x277207db64e3d6a3ULL,
+        0x765c9f72143c4b65ULL, 0xba0282b2f82e0a2fULL, 0x8acd1510bb322aa6ULL, 0xa602c90c455a8a3bULL,
+        0xa26256d1ac604d1fULL, 0xa22859034507f2dcULL, 0x8525c2adec285c96ULL, 0xa92d9f7f446710beULL,
+        0xab6a309ad797e307ULL, 0x139a17c81816e3c5ULL, 0x92eaa6cc6f87b6cbULL, 0xc9aeb9a346f91229ULL,
+        0x4d0b6c4fdf61061eULL, 0x646f958114cb581aULL, 0xea52789f2795d39cULL, 0x011bea72f05842c6ULL,
+        0x98198d7f6049f913ULL, 0x6a8f1662f28fe4b3ULL, 0x934621b93b698c6eULL, 0xeedef69fd82f83cfULL,
+        0x2e950a1c07a84931ULL, 0x09d3c921439849eeULL, 0x5177fcb33020965aULL, 0xbc3ada1684487582ULL,
+        0x707e653e935beb6bULL, 0x8c6648ee07d02dceULL, 0x9d777045ea6fe81fULL, 0xe266bfe1972f1df7ULL,
+        0xec6985fbdd482a53ULL, 0x2525564bf74578ffULL, 0xac9e98b9fd224e54ULL, 0x5ea1bc15b557aa93ULL,
+        0x608c50677839ab91ULL, 0x2c5ff9e17b633bf7ULL, 0x5775bc9eeb0b3be9ULL, 0xfc16e12fc6b96f75ULL,
+        0x4bfe92d09e47b5a5ULL, 0xfe11dbae9c7d3663ULL, 0x0626948b1f6ce72bULL, 0x1cb00eee75a1e205ULL,
+        0x5d797ff00d9ee780ULL, 0x8119fe019c8c1054ULL, 0xf169f2d736e012c4ULL, 0x637c57f209aa01f4ULL,
+        0x6020a1d13ac274a0ULL, 0x54823e1c029a5ce9ULL, 0x301d706982cf17eaULL, 0x92717476a090ed6dULL,
+        0x0474c830abb06a37ULL, 0x573151660f3bf336ULL, 0x94b84da4b602a788ULL, 0x5e46e17a2e52e723ULL,
+    },
+    {
+        0xd91dad37c1ca754cULL, 0x52fdd18dc60449fbULL, 0x60221480b96082c9ULL, 0xcb7e355130ba65d5ULL,
+        0x7805ac57a0cd3970ULL, 0x5402744451c6d1caULL, 0x528ba793b6126c97ULL, 0x4d006b97fe0a20c4ULL,
+        0xed465ff809dd3576ULL, 0xd504081a8df73243ULL, 0x8bd8f5f52797dc3aULL, 0xd66247d35681c4d5ULL,
+        0xdf1a8eef0f57a138ULL, 0x208f36ebc7cffa55ULL, 0xbd1e22d5de8ee967ULL, 0x3d656c17ab57269fULL,
+        0x4e574bb00a1f8768ULL, 0x7f39f01daf990024ULL, 0x9cd11de229fc52b6ULL, 0xc933e1c31492ea10ULL,
+        0xdee0aaeb5586dcffULL, 0xba9b1e06aa2d4455ULL, 0xfacb4c54b8bf7565ULL, 0x0560179c7aa8716bULL,
+        0x2a1d42040a10796cULL, 0xef2d22882e9456dfULL, 0x407055bb8147fa3aULL, 0x417024433db99b83ULL,
+        0x4111fc98b35b6824ULL, 0x736423514d22d53dULL, 0xf3039c43d89d5c41ULL, 0x4197edf9156eac87ULL,
+        0x3fb86838c94e4dc9ULL, 0xe407eec5bdaf2deaULL, 0x42a302be88ad6457ULL, 0x789944e7240c723fULL,
+        0xe2ca04b892d037feULL, 0x7a32d98639efc0a0ULL, 0x65a91d972e2af3d8ULL, 0x629bdf12e0a38176ULL,
+        0x9d9debf7ce55730aULL, 0x42d6e30fa101d564ULL, 0x4dbbe98991f0da4eULL, 0x6ff3d9c8603ebd11ULL,
+        0xcd4748d8394d828bULL, 0xe113550d385cce1aULL, 0x63c3fa49ce210feeULL, 0x2f65cc8d7a21aa98ULL,
+        0x9ca45880e5b17a36ULL, 0xcc9f5eb2fd458833ULL, 0x29e4f09493f18864ULL, 0xcaa09a626d4a0629ULL,
+        0x0062d286e5dbcbedULL, 0x5b137c293e6cca2bULL, 0x335ca22282deaf1dULL, 0x860a07919deca86eULL,
+        0xfb6eca7f187a109dULL, 0x6431de729a5a33bfULL, 0x351cc538a976ede6ULL, 0x63e8177b81bdd572ULL,
+        0xa33efbe21ea487daULL, 0x49f1ae3b4a834ae7ULL, 0xe2dcaf31c4128c38ULL, 0x25733612ae064e09ULL,
+    },
+    {
+        0xa2ab4536e5682232ULL, 0xb05e10fc1f14be19ULL, 0xabad599594223f48ULL, 0x0d31441780b58d55ULL,
+        0x7146d0bbeb207800ULL, 0x0435d31db5411c21ULL, 0x7cf9b660602e62e2ULL, 0xd9e6c883da8aa94fULL,
+        0xfaa5f20a56309cfaULL, 0x1e54292ae63a95a6ULL, 0x79830eba63e66bd5ULL, 0xeba244fe2a1cf99fULL,
+        0xcf974c80ea97203fULL, 0xb23f3d1569473677ULL, 0x447c9cd85fcd3feaULL, 0x121f39f482ccd724ULL,
+        0x20fff7037d125ca1ULL, 0xb9f0525ec057de16ULL, 0xf372c3c0ed0103f3ULL, 0x72c022832977fd89ULL,
+        0x484d385ed1757b34ULL, 0x5c0d0faf64b3f254ULL, 0xf9e6838b87b5b621ULL, 0x424dcff89f881226ULL,
+        0x0d71314ed187c6dfULL, 0x502a36ad121c7793ULL, 0x20a3474812f0f5feULL, 0xa5752eb65fba447eULL,
+        0x2bee29f51559e3feULL, 0xf0255b61ae20a27dULL, 0x244f236f1c40c434ULL, 0x03e79573cdf3f4c4ULL,
+        0x964d14792f31e276ULL, 0x975017afed402c5eULL, 0xc277f9c6ab1560c4ULL, 0x055b1fb2ba735c0fULL,
+        0x1a48d1a203abcc86ULL, 0x9a18cf55f3c3461bULL, 0x9d598347f04631eeULL, 0x7d7e3981b4bdaa35ULL,
+        0x9a6dc7a3468ff16eULL, 0x70731425a23ea149ULL, 0x42182e9169feb9c1ULL, 0x8e7d89e651347fa2ULL,
+        0xe3932284637362feULL, 0x0659e0ae1a36693bULL, 0x9c16504a48e82edaULL, 0x7856e246e77efde6ULL,
+        0x92adf2175aa5aa24ULL, 0xdfa50eec109fa0dfULL, 0x07104682d4a8ef75ULL, 0xf14ea0dd52ec2542ULL,
+        0xa518b80300b0da2eULL, 0x4648b30ac1008be7ULL, 0xfadac955af056495ULL, 0xe59e7f533ef10ed2ULL,
+        0x00dd13e315b5e210ULL, 0x2aecd5aa9ea2524dULL, 0x1e09c587f6fd8e58ULL, 0x37ad6fb6020e4ed9ULL,
+        0x2694688e7a080c2aULL, 0x9381f16667e9ecdcULL, 0x8d5ccfdec64a0b00ULL, 0x8831b3e051acdd03ULL,
+    },
+    {
+        0x92f6243890074c5fULL, 0x49104d99b4e7634fULL, 0xabcedee2ce3bfaabULL, 0xdc9a1c56f7b85065ULL,
+        0x09819f4dc42322bbULL, 0xadecc2d59e890069ULL, 0xa58ea347d48330daULL, 0x00c1127fb91a93ebULL,
+        0x7d1fa5489866a151ULL, 0x39601502c5e2344fULL, 0xeed67f1d54f73d8aULL, 0xdbb2c86a913c3fb1ULL,
+        0x7eb906583683ed3dULL, 0x688eaf37c4859208ULL, 0x13adf5c0a98b8739ULL, 0x573c2ec372af0a89ULL,
+        0x4fda07b731090ea9ULL, 0x272d79b55ff9ce30ULL, 0x370bbbd22d4350f0ULL, 0xe6c2bb053747845eULL,
+        0xb663187c3199907eULL, 0x27248a76de3160c7ULL, 0xdf5931a41c369c8dULL, 0x3efd1ad937ac92dcULL,
+        0x057fef03d781b95bULL, 0xebc08b5984cd03f4ULL, 0xc0b481926da477a6ULL, 0xd4666f19b9045b0dULL,
+        0xf26e6f593156c1c1ULL, 0xdc29aa8ed6220c55ULL, 0xbe6dd04fb504cd54ULL, 0xe2158351ded8e255ULL,
+        0x4aeb9c9751a474c6ULL, 0x77b2213cad9317a5ULL, 0x341ee17d16888fe9ULL, 0x23463d3964a79ca1ULL,
+        0x03ce1b27df94c450ULL, 0xf904caf401455f83ULL, 0x81be96162fb5194cULL, 0x8c5291f3f3bf4ea1ULL,
+        0x41c8e93aba9ead7dULL, 0x6035eb58c1a8c486ULL, 0x32f1b2ed082d857aULL, 0xef35988109f7fdecULL,
+        0x63e22fcd03367928ULL, 0xe6da4b55d209067bULL, 0x1bca461001156575ULL, 0x6679335e14b6d226ULL,
+        0x5230d012fb0aa3fcULL, 0x893c3e43b894dfe3ULL, 0x9841a59d03b4ca5bULL, 0x3077aeeb46b8a4ecULL,
+        0xc9eb11890f48f210ULL, 0xa81b4a589749add1ULL, 0x5d2fea811db0477fULL, 0x8322b7ef797a1677ULL,
+        0x0de0d4a37db2c3dcULL, 0xec583d9f2c50f6a3ULL, 0x02cee1d1bbe04a74ULL, 0xf008e6261189a0a1ULL,
+        0xda98f9129eb3fc01ULL, 0xd2eb7e829add6386ULL, 0x30fd99dee033c3beULL, 0xbf36c8c6a4ecba15ULL,
+    },
+    {
+        0xc62790c5061f359aULL, 0x369537636203e399ULL, 0x587c973ea103db7dULL, 0x8053cf4c20de871eULL,
+        0x83107e6307004406ULL, 0x29cbb9b3d45766daULL, 0x28090a7cd5800febULL, 0x70e202731457d51fULL,
+        0x7cb67f1eed647401ULL, 0x8920c69bcea4f415ULL, 0x581d0ecc1f8e2e28ULL, 0x6aedf65b6f3cbd30ULL,
+        0x48b64694ccc669b5ULL, 0x695baae2ce656185ULL, 0xcb069c65c28a8c33ULL, 0x4f6a029826c7d46bULL,
+        0xc396cd593216dc56ULL, 0x2266b0ce88474f1bULL, 0xdca4eb3bb165a56fULL, 0x96cac410cb864eceULL,
+        0x4ff1f3d4410b5c4cULL, 0x56837dabadd5cf68ULL, 0x133bc19c76852430ULL, 0x68a1d30b5709bfaeULL,
+        0x4eada1fca000eff9ULL, 0xa24f7b66fa7fb5e9ULL, 0xe641c8de6fbd8b90ULL, 0x2309c00b53ad3060ULL,
+        0x21714885fd948f93ULL, 0x82cfda440259377aULL, 0x96dbf87ff559f690ULL, 0x4d4a9640e009aaafULL,
+        0xb16232192442ec7eULL, 0xb93fcdc796525bd9ULL, 0x95148b9555ee813fULL, 0x84879b8f4cac3218ULL,
+        0x3ad2f944e11d3ca5ULL, 0x78ff0380e6d65b5aULL, 0xc8de2c7444dc3356ULL, 0x4e4267e20a3c3caeULL,
+        0xb9e022fee8dedc34ULL, 0xf4e9bd65c649dd6dULL, 0xfba3207d3822e1efULL, 0x00da9b5f7fbf81c8ULL,
+        0xc23f3bfb74c19370ULL, 0xfcd668a4637177baULL, 0x000d23a5e8e1b3fbULL, 0xc358b8823acf1b8dULL,
+        0x31e07bf1d70fae4dULL, 0x2dda3276833136acULL, 0xd83fec6f60579303ULL, 0x17d0868b2639d545ULL,
+        0x4b3c9519ae9d3de3ULL, 0x4ea33e2a01b9af33ULL, 0xf82767e03e37fc7aULL, 0x73483b546b9b1c74ULL,
+        0x064801a3af55e46eULL, 0x411a8b0ad65951e6ULL, 0x0e5175695c19cc7cULL, 0x21cbd7a80c1a63d3ULL,
+        0xc6ed990aa7799e7fULL, 0x1f9f6e2768ee3b14ULL, 0xf44b937368734307ULL, 0xf594f5709042c47fULL,
+    },
+    {
+        0x3f7b56f03b48a906ULL, 0xc4e3f88b2cdbc080ULL, 0x46028ab3f7d5ce9eULL, 0x433849766086d9d9ULL,
+        0x1a6b962c38771e10ULL, 0x8617631258f71639ULL, 0x290b8146cd300576ULL, 0x7e4e3632b9a6bfb1ULL,
+        0xf037b05f0b0f3d79ULL, 0x4b0f4e209053ea58ULL, 0xbee882572b0842a6ULL, 0x2bc262d801f29d00ULL,
+        0x5611511c98983ed7ULL, 0xb5b3fb76651566a0ULL, 0x22c08684ee502e5aULL, 0x847e0fbde1547a9fULL,
+        0x7c48519e553aaa03ULL, 0x12a15dad8c0cacb2ULL, 0x001fe9e6f8fab90bULL, 0x85ccabaa6019c438ULL,
+        0xadceafb067eac69eULL, 0xc33445c1dce4f63bULL, 0x2c8a62283a4aebbbULL, 0x5412eeca19be35f5ULL,
+        0x9a40cb81592e4a7eULL, 0x27aaa6a72d1a329bULL, 0x176e45edceccd297ULL, 0xf0ed0f15036f45deULL,
+        0x429a91f9fde39fb6ULL, 0x11c5d5e4135908c2ULL, 0x50b40e390364a452ULL, 0x54945393ff39a4e8ULL,
+        0x122e4abbf5e96e99ULL, 0xe5c0e2a0d4d5e6e2ULL, 0xa4d22a06a973707fULL, 0xc3d954d1b0a9bd2dULL,
+        0x8075bc07c0080553ULL, 0xfa233f7df09ca607ULL, 0xb67d3fc81df94938ULL, 0x1d7b66eeaf251b57ULL,
+        0xe58ee465d9365382ULL, 0x87ad6d01b93d3c04ULL, 0x0df870dc41e675b1ULL, 0x59394a20d8d77735ULL,
+        0x8f7e148da1fc91c5ULL, 0x0b97f1849bd8ac2aULL, 0xaa1b77b08497c53eULL, 0x2439a47ee722e542ULL,
+        0x3000647e4a40e1dbULL, 0x7a283242f43f189dULL, 0xdce8ab91d47515fdULL, 0x5851fb26469fb452ULL,
+        0xae89500f0e06b7dfULL, 0x3ab271e242761c47ULL, 0xa05e847fcbda3ee0ULL, 0x28674003f248e10eULL,
+        0xb81ce0bb19ee96deULL, 0xc42fe4846252e70aULL, 0xe6e31b4ea1e1b1f2ULL, 0x118e252dd4ced261ULL,
+        0x0a1282141e823ddbULL, 0xe4c352478fd668b0ULL, 0x1ee195d4759f3c66ULL, 0x33672e5487634845ULL,
+    },
+    {
+        0xd449f7491ddae445ULL, 0xfcbd3211ab19211eULL, 0x1ac30a40543426f3ULL, 0xa68604c35982ebb9ULL,
+        0x34e7a6504191a041ULL, 0xe86b3a18a1aac9d5ULL, 0xee64b283fcde2654ULL, 0xe626a7788babccd3ULL,
+        0x21da846bfab39a6bULL, 0x372a83ecf5a663b8ULL, 0x1ecd539cd8ff014aULL, 0x11987cd9765481d4ULL,
+        0x1e238e151d49f1abULL, 0x269f93b2cc92ee07ULL, 0xe09b194f00bb4511ULL, 0x878a26c6a26dd3e1ULL,
+        0xb58464a4c3c0584cULL, 0xb01d2c06be9c9827ULL, 0x097d24f4a16ad8d2ULL, 0x3ff1de68a8ee1ac6ULL,
+        0x63452d80bf1377e9ULL, 0x51f583ac0c46f4a7ULL, 0x7ee2d7754e0a2d1dULL, 0xd1ec7624b0a544b1ULL,
+        0x6f2f95b136fe22aeULL, 0xd41779833e68c214ULL, 0xc2596ec0f98a53b7ULL, 0x6929360c87af13d7ULL,
+        0x5d923b120f440cb9ULL, 0xdc64c2b5a210543aULL, 0x8a8fd79704f9ab91ULL, 0x255e77bd70600408ULL,
+        0xb0a2282d17641426ULL, 0x2bfd7b724260b987ULL, 0x5c19d8c34caa4f7dULL, 0xa874cb62af743ef3ULL,
+        0x14b54851abb14c05ULL, 0xea29ffa6889f0aefULL, 0x2a366e2acf8a47eaULL, 0xb9d0ebd490d73aebULL,
+        0x3188f31c28c4d810ULL, 0xbe4c736422a8f7c7ULL, 0x9b4305b64c096be3ULL, 0xf5ebc8a50e197589ULL,
+        0x9e833a9ceb00c469ULL, 0xbb1223acf8c72c37ULL, 0xc64c6b2a11543c14ULL, 0x7bc0c6ca7ee46e26ULL,
+        0x6eb8e3a1157013daULL, 0xe6a03fe6faa169f1ULL, 0x8fb6c050fd484eceULL, 0xc9dc5e479d7c1e49ULL,
+        0xd15c02e4cd297d0fULL, 0x5367bd195d84e83cULL, 0xd722ad105a4d0a18ULL, 0x3596e65587c945ceULL,
+        0x2a2c79c04d2132c6ULL, 0xe6bfbaf62714187eULL, 0xae2b29778ab9aafcULL, 0x556ba93416026d6eULL,
+        0xadd31e725a3a7379ULL, 0x5e42e294ea456057ULL, 0x87827e811e0f15ccULL, 0x6430c3a6a9c0065cULL,
+    },
+    {
+        0x7c13a7a2e8366346ULL, 0x342e1b82e8e48971ULL, 0x0e2b375930e67092ULL, 0x061309ab3ee11628ULL,
+        0x470b68e38a694363ULL, 0x97fd7385b0949c95ULL, 0x77414375a302e822ULL, 0x1713c5246eff463dULL,
+        0x089c4a45e2e3e893ULL, 0x6361c2cb48989d81ULL, 0xe41bb553bce91728ULL, 0x3dfbe04f11bd84a9ULL,
+        0xd23991f51fda067aULL, 0x7e936f5d187194e5ULL, 0x3586c74da40bc3d7ULL, 0x292d6f8c1d156894ULL,
+        0x64429dbd44d626aaULL, 0x7091c6c6e96508ccULL, 0xc2261dfad22b6357ULL, 0x94228105517bdab3ULL,
+        0xeca2e56680ae1e3cULL, 0x2319796c0fdfb802ULL, 0xb4ac22b760a42619ULL, 0x90d8efbf5fa72532ULL,
+        0xb003640135b1cec5ULL, 0xf7f21211d91bd7d3ULL, 0xe3848843b69544dfULL, 0xe1a8e853a0be842eULL,
+        0x794f5f31d4ee1ae6ULL, 0xdb00c509025ccf52ULL, 0x092e1bb35a8efca8ULL, 0x14f5492320b7bec0ULL,
+        0x1a405d63b23bdf27ULL, 0xbe52499847ec6f77ULL, 0xe09f68221c2e71ddULL, 0x08f1a84730ee4a41ULL,
+        0x7b7f506fdfd53f89ULL, 0x35bafe21cd2657d9ULL, 0xebf519f8b2716625ULL, 0x08e113e4451ff704ULL,
+        0xbe3c153a4bc7b76fULL, 0xb78fb3419cf4f828ULL, 0xe1e3fbaa7ce228c9ULL, 0x17702517e375c809ULL,
+        0xfeeea27b1773e061ULL, 0x3949005d51a64acaULL, 0x711b04a9e1d89ff4ULL, 0x8d3bd9933871fb9bULL,
+        0x23554ae69b13abffULL, 0x8717e5930dc103c6ULL, 0x2417a151bf9e0518ULL, 0xa6d8cce166cdc861ULL,
+        0xff840625ae1af86dULL, 0x4e7bc3ce2f798ae8ULL, 0xd742d2b47c8d82e9ULL, 0xaff0c7c8f7ac9ac2ULL,
+        0xb8f2c39568900d15ULL, 0x4633db69925f6253ULL, 0xf27025070d949696ULL, 0x8a41117745454804ULL,
+        0xc8140137ea09a26fULL, 0xfdc2977fd76f722eULL, 0x40c3021d645b8664ULL, 0xd27f927241110cebULL,
+    },
+    {
+        0xa95088c50b688949ULL, 0xbebe1f0124521a82ULL, 0x2334bfe46be4a3a8ULL, 0x7579ba665b4cd061ULL,
+        0x949ebddb819eaea9ULL, 0xdf9887bba6139e0aULL, 0xbbce5917cdb7ebaaULL, 0xc162fd2dde0fa52eULL,
+        0x492e6c87ab24fda1ULL, 0x26fb1be27ba722cbULL, 0x259241c05f6490bdULL, 0x0db21bb28fa6ddb1ULL,
+        0x98b6806c12f6b1cbULL, 0x79b0de0cfb5110fbULL, 0xcb7d8c3702b97bcbULL, 0xbf71197f183931dbULL,
+        0xc142335fea6501e2ULL, 0xf3ac401319ec25a9ULL, 0xecc5bd5e2559a1d6ULL, 0xbc7275c48dcff9efULL,
+        0x603e7bfa4d924059ULL, 0x1f263dd5e4d2dac0ULL, 0xc41de597736754aeULL, 0x0d6677751996163cULL,
+        0xd3596fe5be1d9093ULL, 0x49be0969cc832d36ULL, 0x275e6d4508b2b2bdULL, 0xea1d7d8aa39eda35ULL,
+        0xec19bf16cc687109ULL, 0xa9b39902533b6f85ULL, 0xf2bf6936ba8c71d4ULL, 0xfa2a975126601f8eULL,
+        0x7ccac972175e5bf9ULL, 0xd89cddd674083053ULL, 0xc7aec42f84dc6f62ULL, 0x9ab90fcb89a7606eULL,
+        0x921d338e82f2d23cULL, 0x6ca9f9093143a4e3ULL, 0x23c673486b7e9200ULL, 0xc80a05f0331bfa46ULL,
+        0x7587a292f4e1126eULL, 0x22edccfdb590c6a6ULL, 0x907db4ab1b28c0cdULL, 0xdd29b244c4777ea2ULL,
+        0x2d508b88c335c692ULL, 0xf773692d8f61fd47ULL, 0x3d47306515bfe4acULL, 0x77f8b2caf7012a40ULL,
+        0x86012b5b3fcf0ca1ULL, 0xdba645752d842b79ULL, 0x08c98dcedb990727ULL, 0xe0370139a458cf58ULL,
+        0x8851d76373ecd80bULL, 0x230a556e11fb5c23ULL, 0x36f39157cf47d2d3ULL, 0x123d4a8833b8ce36ULL,
+        0x74c72f459bb94ad0ULL, 0x5182f6b7a1d40a3dULL, 0xdfaa245f17f3c525ULL, 0xf6393029c19888c8ULL,
+        0x4fcae72fa87b48caULL, 0xc119872e8130fe28ULL, 0xf361b64272eb5794ULL, 0x03207ef1e9fb654aULL,
+    },
+    {
+        0x02855d0b39891d46ULL, 0x0b65d5120a3e10a1ULL, 0x62af7534f4ea4aa2ULL, 0x27c3cba5f94b3c97ULL,
+        0xd5657bcd6904a639ULL, 0xf6f1a24895baee22ULL, 0x8ed150a25384de00ULL, 0xc19cbf88015c6676ULL,
+        0x8c665de398ec37c6ULL, 0x08926b5e5dcc8e68ULL, 0x4bac40914a2cb77fULL, 0xaafc3b20a7867a2eULL,
+        0x7a47d3bacdc4416cULL, 0xa19819f5637b6e60ULL, 0x736c62171d685568ULL, 0x5e470b296bb71c09ULL,
+        0x56bf8d9fb3a6399fULL, 0xf40a3a1363072025ULL, 0x0633f8e7dd922f19ULL, 0xcc79e3600685f1a4ULL,
+        0x1d028c8c6b8868adULL, 0x46eb6acc8bded78dULL, 0x6056a7df5e011dd9ULL, 0x0fdec369d157f5acULL,
+        0x2a68a236737a1097ULL, 0x8288ca5de6f454c6ULL, 0xfbf55cb33fc95388ULL, 0x50b96b536340861aULL,
+        0xdb8a00bf027f292cULL, 0xf558eef977cc2365ULL, 0x9f13b0aa7e646103ULL, 0xc2b491bdc44bea4bULL,
+        0xd9ec23808a823b9eULL, 0x9660992a5a29d4aeULL, 0x2884e0ca20beae69ULL, 0xcd72142132fdd5b8ULL,
+        0xad3debc5b91db415ULL, 0xaa73e5843afa31b6ULL, 0xe3963248f7c06a39ULL, 0x7d6998e2e4ad09dfULL,
+        0xade7f429c7a55848ULL, 0x3b331534e0dee566ULL, 0x124c8f8058911807ULL, 0xf782b989c9f0ea6cULL,
+        0xcbed4a9db22da572ULL, 0xc2db3f4931301b6bULL, 0x64b6f5472f53343fULL, 0x44647df4e3d9bb05ULL,
+        0x685dba96344a3df7ULL, 0xbad52e9da4227ef6ULL, 0xb6a86fb09d73fb67ULL, 0xf904ed1cf8e52022ULL,
+        0xc299a5973085a5f9ULL, 0xe1b4d158c084943dULL, 0xfb04dc04446e0f53ULL, 0xf92ba69932a59ecdULL,
+        0x3d971712f3edd699ULL, 0x83561813795a93a8ULL, 0xe310f4dc383df049ULL, 0x0557dd099018b1eeULL,
+        0x2b5eee2f71c23507ULL, 0xd5b76d10207b3f09ULL, 0x2f63e4f0293907c7ULL, 0x6429aca17b7fc0ccULL,
+    },
+    {
+        0x5ef47aba1c7c6448ULL, 0x7054621597c6e3c9ULL, 0x37f92b53f89882c6ULL, 0x9bfa645b51bf3c41ULL,
+        0x66d2f85639681224ULL, 0xfe12a5777e727919ULL, 0x9e180fab8a1421dfULL, 0x0ec40caeaf6d7756ULL,
+        0xfdd7217d84cd2d03ULL, 0x942238a0b00aafecULL, 0x41dc88c37392745dULL, 0xa34577f4560c3760ULL,
+        0x50ba2358c39292dbULL, 0x7d2a3b3fe53f724bULL, 0xb651299c05c7f448ULL, 0x76c2a9bdc04aee91ULL,
+        0xac4ee360fa33b7baULL, 0x1c351bcc8737b6c2ULL, 0xddc3ccb99862a130ULL, 0xd369f9f5a98868baULL,
+        0xd2b46da32830fffeULL, 0x08aed41094ddae41ULL, 0x43ef10e8727cb976ULL, 0x0e6bc616a2317c89ULL,
+        0x12044e5677a4c632ULL, 0x0892b4cd3204a04cULL, 0x82c1e564204a9701ULL, 0x883093c5ab908602ULL,
+        0xdd146e93e2dff44aULL, 0x489a9cde1fd72f0eULL, 0xbcf9af6280a334e8ULL, 0x5464887c8ac58f65ULL,
+        0x90fd19fd272d6a63ULL, 0x37976bc9ced9a717ULL, 0xfd3dc9a92e74a076ULL, 0x2bc5ae50318ad2c8ULL,
+        0x28eb1b3d1310b782ULL, 0xbf4a93b5f11e4785ULL, 0x4c9267698c0850c3ULL, 0x51cd57a507f5bcf4ULL,
+        0xd653513c426e0bccULL, 0xd6a83529775613c9ULL, 0x3d6063319bfb64d2ULL, 0xa64d62c3fdeca428ULL,
+        0xfb0354f068071d63ULL, 0xb18614e587da3d19ULL, 0x81eef328362aee03ULL, 0x2a28e519b65c83eeULL,
+        0x7888f6fcc5e2f105ULL, 0x85e903eca35a896eULL, 0x3a620881ac1c8eddULL, 0x29c6b5a94db47a27ULL,
+        0x0e5eb147974946e2ULL, 0x6198b8a272e099e2ULL, 0x7b86ec3b345b896dULL, 0xd3a1c604e628a803ULL,
+        0x4d558fca9fde1e0fULL, 0xef4ef3e4a9a100e3ULL, 0x1ef10c37823801bfULL, 0xa56fc1e04546f021ULL,
+        0xfac77f2173306f52ULL, 0xd596658c17901bf4ULL, 0xd44a391188521c42ULL, 0x934317cfb112a77cULL,
+    },
+    {
+        0x932c1cbb3b9c7633ULL, 0xee24f088da65d794ULL, 0x9c1d9ff8a04698d0ULL, 0xef795655cba8e7c1ULL,
+        0xac0f9cff5c3c5262ULL, 0x26efaea476c9fbacULL, 0x33aadba3c7bc6546ULL, 0x7d7c69a445710250ULL,
+        0xa05011c0dffe7edbULL, 0xfc7bc7eb5ae90764ULL, 0x114f23a7a0899c55ULL, 0x1f33dd70cb84e551ULL,
+        0x587691a7dfe05e5aULL, 0x8059fd96b97f0de1ULL, 0xc1b991ab2f2e223fULL, 0x1f234dfb2f8bc076ULL,
+        0xacceb1a7c8e61687ULL, 0x8cad94e9a11de0f9ULL, 0x423e080a8cff4c05ULL, 0x07ee350e5b2b58acULL,
+        0x335c1e805bbb53f6ULL, 0x654c64e53a24323eULL, 0x390a9fafb1382655ULL, 0xbbc229d749fba918ULL,
+        0xeae730cfd548451dULL, 0xcc652c78c539918cULL, 0x2fd75516876ba48aULL, 0x9ea5cc78699bfab9ULL,
+        0x6d9ff93c9173ab25ULL, 0xf5d80c866d12e73cULL, 0x5ae774e3a5827debULL, 0x4207ce8f5e0acb1aULL,
+        0xa635e1d7a6e0dc33ULL, 0x649684105b066d24ULL, 0xe06645d4d451b94cULL, 0x2d442aa29c013b07ULL,
+        0xfab9fa61c375b7b5ULL, 0xb9f06cc654ea7670ULL, 0x41dbc0bcaaca05b0ULL, 0xad79de573954d6b7ULL,
+        0xbcbc2dade5dd948aULL, 0x57789b03a14e6606ULL, 0x4bec7003bf631fefULL, 0xc6ada619c5a08774ULL,
+        0x46d9ca164fa25409ULL, 0x6f1b44b82d82b960ULL, 0x5f09441fea471f4fULL, 0xb21b7f3390dc4338ULL,
+        0x5b16e6983761fb96ULL, 0x285d24b2b65a5558ULL, 0x4643773be1b22166ULL, 0xec04947bc895af20ULL,
+        0xfcdd5377f4592da9ULL, 0x4b4e31fdc895e0a9ULL, 0x4d1c0698091d52f6ULL, 0x98e438490fe383e1ULL,
+        0x714257ab0234744aULL, 0x291fa07d9807a64aULL, 0x7045e71d026bfa00ULL, 0xfcc3fb858f7678ebULL,
+        0x1fbbb9fc1c33d5f3ULL, 0xf5641e593b8d15b2ULL, 0xca4acf7ee7e33ea4ULL, 0x7bd8afdc5c42ec2bULL,
+    },
+    {
+        0xd93789274f9c6176ULL, 0xe79d2095de3b13bbULL, 0x0b071b32757b9c62ULL, 0x2589bdc39870a848ULL,
+        0x2b1d7a1ec675d3b2ULL, 0xfe6dd8ecccdf0db6ULL, 0x91e36197f02879e7ULL, 0x26a24adcee29d4edULL,
+        0x0b1958100ee5bc3cULL, 0xc95d73aa70debd9cULL, 0x6c1d14ecce194164ULL, 0x8a5e0e73beed02afULL,
+        0xd71cc21e2207941fULL, 0x6b61005b3b0b7a2fULL, 0x161e12a1a4672f10ULL, 0x5e9fd816fccae17bULL,
+        0x21a762840424b409ULL, 0x978cc3bbff85ab5aULL, 0xc6357386de5a7c57ULL, 0x4677745db06e1590ULL,
+        0xccf3cc5c9ac99995ULL, 0x145c5b2f56a539e3ULL, 0xf1d75ff4ac0a943fULL, 0xe47ac1ab8eb0bb57ULL,
+        0x7dd71e1f1a7f817cULL, 0x85980a12654496ecULL, 0x1bf9525826f55b53ULL, 0x2b43e2a00fac0691ULL,
+        0xccaea29517852086ULL, 0x0fdb07fc448e6f4aULL, 0x4eafcfbd220c4d0bULL, 0xda14208b255037e0ULL,
+        0x7f55bdb2f10ebc90ULL, 0xa8584999fe754580ULL, 0x2dd5fd0104f0e60aULL, 0x32631bf3c6ed766fULL,
+        0xe83e9cc879d017ceULL, 0x16dd685ea4dc0891ULL, 0xea91ced8c8b30640ULL, 0x3537d04760fe0d84ULL,
+        0xa6920bf03d6cdaf0ULL, 0x0c49af169a83a9c3ULL, 0x4355159cf1791ccbULL, 0x305e4ee6e5c8a867ULL,
+        0x46256ab6ef8e9368ULL, 0x01d6f673eea3ade6ULL, 0xc32df3cb9e8578a0ULL, 0xb06891bed75c7127ULL,
+        0x5f30aefda6ca40a7ULL, 0xc7e53283bef99247ULL, 0x11aa85e5d410b286ULL, 0xf615e34894590d71ULL,
+        0xe2edee45e34dc3b5ULL, 0x2cdc3bd603e7c7b7ULL, 0x65d2440f14e7ddf2ULL, 0xff846c7205b9c083ULL,
+        0x235e6070ea16c8cbULL, 0x1babd5927ec263b5ULL, 0xde3315a4fb0631fcULL, 0x0fe812d3e0b8e803ULL,
+        0x0839f06887822364ULL, 0xdf3353a576b0a1e7ULL, 0x37da77202d8c5692ULL, 0x7f93eb62cd05681bULL,
+    },
+    {
+        0x9e8d117e05447d70ULL, 0xa204693d40a84c85ULL, 0x3e4fad3045f1d23bULL, 0xe00616e64e949c9cULL,
+        0xa0e4ab8a1d678e5cULL, 0x1738bb122dbb1c1fULL, 0x6aee16c49a25c71bULL, 0xad2e15dbfb69917bULL,
+        0x338699e9587be78eULL, 0xaf980b0dcfa661c6ULL, 0x00bfae184d3876f8ULL, 0x28b110935584d279ULL,
+        0x73577f301b68efdcULL, 0xa8ea309a64128524ULL, 0x307f8589c7307f6bULL, 0xb02ae52da445a688ULL,
+        0x170b83329ec30a9cULL, 0x6fd2b929ca23b518ULL, 0x26d599f6cfb72e13ULL, 0x6981126af0d94f97ULL,
+        0x5335f57586c0cafeULL, 0xe2417cadb4296160ULL, 0xdeb23ed254e7f421ULL, 0xba04b34b906f3396ULL,
+        0xa75467ac75261392ULL, 0x6bbdf04142e29188ULL, 0xa554e562e70bd691ULL, 0xef4cb1847b162eb2ULL,
+        0x08c365bc9f1eb244ULL, 0xfdaacb36caad35caULL, 0x87016dc5d7ec9586ULL, 0x6d5d49538d5eb9b9ULL,
+        0xefdf04253f601d27ULL, 0x56d0f3066eb44e58ULL, 0x33e65d967772998cULL, 0x1a491dcbcd4e3f52ULL,
+        0xa61501fb1d4dabefULL, 0x922dddc6d94a9645ULL, 0x89bee7f22d57bc99ULL, 0xf2f2d734dea6ac8aULL,
+        0x5b3d3fcb8cc8ea51ULL, 0x6e363cfd4728f1e6ULL, 0xfe978121e922b7e7ULL, 0xb621dc80d2b64f82ULL,
+        0xe6f18981792823ffULL, 0x6e53ce38778ca9cdULL, 0x6a0c027be7e5bd74ULL, 0x619c69087ef6c9d9ULL,
+        0x9715dba2128e1ee4ULL, 0x6363a35dd97c9780ULL, 0x1e185bafbd3b374bULL, 0x7ec27b0f89060765ULL,
+        0x0c1cb6238b265f76ULL, 0x7745996b427eddb5ULL, 0x592a5fd2cf6f770eULL, 0xb16a4e9849d854fbULL,
+        0x69959c5a3542a447ULL, 0x5c98bedd3edd8d34ULL, 0xf8457d14f83dc9c2ULL, 0x5c3e943110d2e7c2ULL,
+        0xb30a0f2ddb9fabaaULL, 0x86e440da3f01762aULL, 0x185a33b533946a8eULL, 0x2366a15bf9d08637ULL,
+    },
+};
+
+// Indexed by the CASTLE_* flags. Each entry is the xor of the keys of its
+// single rights, so that losing one right changes only its part.
+const uint64_t zobristCastlingKeys[16] = {
+    0x0000000000000000ULL, 0x28aac3fa957fd0e5ULL, 0xd77ac057517dd35eULL, 0xffd003adc40203bbULL,
+    0x12110a99d90e0ad4ULL, 0x3abbc9634c71da31ULL, 0xc56bcace8873d98aULL, 0xedc109341d0c096fULL,
+    0x6c3c2cc4013ed4bcULL, 0x4496ef3e94410459ULL, 0xbb46ec93504307e2ULL, 0x93ec2f69c53cd707ULL,
+    0x7e2d265dd830de68ULL, 0x5687e5a74d4f0e8dULL, 0xa957e60a894d0d36ULL, 0x81fd25f01c32ddd3ULL,
+};
+
+// Indexed by the column of the en passant square.
+const uint64_t zobristEpKeys[8] = {
+    0xd8d6c40d66f1e737ULL, 0xbfbb8ba18cbc1e8eULL, 0x257b9d9245aaf5a1ULL, 0x2762796e43dac1feULL,
+    0x800cef78d14157a5ULL, 0x2f0fe33ed10e75b1ULL, 0x77a1befdcb08a476ULL, 0xfe8b4f12bc54e3e0ULL,
+};
+
+const uint64_t zobristBlackToMoveKey = 0x6a29951f5a59a8bdULL;
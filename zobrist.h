@@ -0,0 +1,11 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+
+extern const uint64_t zobristPieceKeys[16][64];
+extern const uint64_t zobristCastlingKeys[16];
+extern const uint64_t zobristEpKeys[8];
+extern const uint64_t zobristBlackToMoveKey;
+
+#endif